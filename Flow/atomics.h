@@ -0,0 +1,54 @@
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+#ifndef __GNUC__
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchange, _InterlockedCompareExchange)
+#endif
+
+//a value shared by threads without a lock, it is only read and written with the functions below
+typedef volatile long AtomicInt;
+
+/// <summary>
+/// Reads a shared value, what the thread storing it wrote before is seen after it.
+/// </summary>
+/// <param name="value">The value.</param>
+/// <returns>Returns the value.</returns>
+static __inline long AtomicLoad(AtomicInt *value)
+{
+#ifdef __GNUC__
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+	return _InterlockedCompareExchange(value, 0, 0);
+#endif
+}
+
+/// <summary>
+/// Stores a shared value, what this thread wrote before is seen by the threads reading it.
+/// </summary>
+/// <param name="value">The value.</param>
+/// <param name="newValue">The value to store.</param>
+static __inline void AtomicStore(AtomicInt *value, long newValue)
+{
+#ifdef __GNUC__
+	__atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+#else
+	_InterlockedExchange(value, newValue);
+#endif
+}
+
+/// <summary>
+/// Keeps the reads and writes before it from being moved after the ones that follow it.
+/// </summary>
+static __inline void AtomicFence()
+{
+#ifdef __GNUC__
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+	long barrier;
+	//the Interlocked functions are full barriers
+	_InterlockedExchange(&barrier, 0);
+#endif
+}
+
+#endif
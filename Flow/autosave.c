@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "autosave.h"
+
+/// <summary>
+/// Flushes a file and waits until its data is on disk.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int SyncFile(FILE *file)
+{
+	if (fflush(file) != 0)
+		return -1;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0 ? 0 : -1;
+#else
+	return fsync(fileno(file)) == 0 ? 0 : -1;
+#endif
+}
+
+/// <summary>
+/// Replaces a file by another one in one step.
+/// </summary>
+/// <param name="from">The path of the new file.</param>
+/// <param name="to">The path of the file to replace.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ReplaceWithFile(const char *from, const char *to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+	return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
+/// <summary>
+/// Writes a file through a synced temporary file, so it is either the old or the new file after a crash.
+/// </summary>
+/// <param name="path">The path of the file.</param>
+/// <param name="data">The new content.</param>
+/// <param name="size">The size of the content.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int WriteFileAtomically(const char *path, const char *data, size_t size)
+{
+	char temp[FILENAME_MAX];
+	FILE *file;
+	int result = 0;
+	if (strlen(path) + 5 > sizeof(temp))
+		return -1;
+	sprintf(temp, "%s.tmp", path);
+	if ((file = fopen(temp, "wb")) == NULL)
+		return -1;
+	if (fwrite(data, 1, size, file) != size || SyncFile(file) == -1)
+		result = -1;
+	if (fclose(file) != 0)
+		result = -1;
+	if (result == 0 && ReplaceWithFile(temp, path) == -1)
+		result = -1;
+	if (result == -1)
+		remove(temp);
+	return result;
+}
+
+/// <summary>
+/// Writes a batch of changes, only the last change of a level and the last high scores are written.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+/// <param name="events">The changes in the order they were posted.</param>
+/// <param name="count">The number of changes.</param>
+void WriteAutosaveEvents(Autosave *autosave, const AutosaveEvent *events, int count)
+{
+	const AutosaveEvent *scores = NULL;
+	char text[64];
+	int i, j;
+	for (i = 0; i < count; i++)
+	{
+		if (events[i].type == ScoresChanged)
+		{
+			scores = &events[i];
+			continue;
+		}
+		for (j = i + 1; j < count; j++)
+			if (events[j].type == ProgressChanged && events[j].level == events[i].level)
+				break;
+		if (j == count)
+			AppendProgress(autosave->journal, events[i].level, events[i].state, events[i].timeRecord);
+	}
+	if (scores != NULL)
+	{
+		sprintf(text, "%d,%d,%d", scores->scores[0], scores->scores[1], scores->scores[2]);
+		WriteFileAtomically(autosave->scoresPath, text, strlen(text));
+	}
+}
+
+/// <summary>
+/// Waits for posted changes and writes them until the autosave is stopped.
+/// </summary>
+/// <param name="data">The autosave.</param>
+/// <returns>Returns 0.</returns>
+int AutosaveThread(void *data)
+{
+	Autosave *autosave = (Autosave *)data;
+	AutosaveEvent *batch = NULL, *swap;
+	int count, capacity = 0, swapCapacity;
+	SDL_LockMutex(autosave->lock);
+	while (1)
+	{
+		while (autosave->queued == 0 && !autosave->stopping)
+			SDL_CondWait(autosave->posted, autosave->lock);
+		if (autosave->queued == 0)
+			break; //stopped and everything is written
+		//take the whole queue, the game goes on posting to the other buffer
+		swap = autosave->queue;
+		autosave->queue = batch;
+		batch = swap;
+		count = autosave->queued;
+		autosave->queued = 0;
+		swapCapacity = autosave->queueCapacity;
+		autosave->queueCapacity = capacity;
+		capacity = swapCapacity;
+		SDL_UnlockMutex(autosave->lock);
+		WriteAutosaveEvents(autosave, batch, count);
+		SDL_LockMutex(autosave->lock);
+	}
+	SDL_UnlockMutex(autosave->lock);
+	free(batch);
+	return 0;
+}
+
+/// <summary>
+/// Starts the thread writing the changes of the game.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+/// <param name="journal">The journal of the level progress.</param>
+/// <param name="scoresPath">The path of the time trial high scores.</param>
+/// <returns>Returns -1 if the changes will be written right away, 0 otherwise.</returns>
+int StartAutosave(Autosave *autosave, ProgressJournal *journal, const char *scoresPath)
+{
+	memset(autosave, 0, sizeof(Autosave));
+	autosave->journal = journal;
+	autosave->scoresPath = scoresPath;
+	if ((autosave->lock = SDL_CreateMutex()) == NULL || (autosave->posted = SDL_CreateCond()) == NULL ||
+		(autosave->thread = SDL_CreateThread(AutosaveThread, autosave)) == NULL)
+		return -1;
+	return 0;
+}
+
+/// <summary>
+/// Queues a change for the autosave thread.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+/// <param name="event">The change.</param>
+void PostAutosaveEvent(Autosave *autosave, const AutosaveEvent *event)
+{
+	AutosaveEvent *queueTemp;
+	if (autosave->thread == NULL)
+	{
+		WriteAutosaveEvents(autosave, event, 1);
+		return;
+	}
+	SDL_LockMutex(autosave->lock);
+	if (autosave->queued == autosave->queueCapacity)
+	{
+		queueTemp = (AutosaveEvent *)realloc(autosave->queue,
+			(autosave->queueCapacity ? autosave->queueCapacity * 2 : 16) * sizeof(AutosaveEvent));
+		if (queueTemp == NULL)
+		{
+			SDL_UnlockMutex(autosave->lock);
+			WriteAutosaveEvents(autosave, event, 1);
+			return;
+		}
+		autosave->queue = queueTemp;
+		autosave->queueCapacity = autosave->queueCapacity ? autosave->queueCapacity * 2 : 16;
+	}
+	autosave->queue[autosave->queued++] = *event;
+	SDL_CondSignal(autosave->posted);
+	SDL_UnlockMutex(autosave->lock);
+}
+
+/// <summary>
+/// Posts a change of a level of the journaled pack.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+/// <param name="level">The index of the level.</param>
+/// <param name="state">The new state.</param>
+/// <param name="timeRecord">The new best time.</param>
+void PostProgress(Autosave *autosave, int level, LevelState state, Uint32 timeRecord)
+{
+	AutosaveEvent event;
+	event.type = ProgressChanged;
+	event.level = level;
+	event.state = state;
+	event.timeRecord = timeRecord;
+	PostAutosaveEvent(autosave, &event);
+}
+
+/// <summary>
+/// Posts new time trial high scores.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+/// <param name="scores">The three high scores.</param>
+void PostScores(Autosave *autosave, const int *scores)
+{
+	AutosaveEvent event;
+	event.type = ScoresChanged;
+	memcpy(event.scores, scores, sizeof(event.scores));
+	PostAutosaveEvent(autosave, &event);
+}
+
+/// <summary>
+/// Writes the changes still queued and stops the autosave thread.
+/// </summary>
+/// <param name="autosave">The autosave.</param>
+void StopAutosave(Autosave *autosave)
+{
+	if (autosave->thread != NULL)
+	{
+		SDL_LockMutex(autosave->lock);
+		autosave->stopping = 1;
+		SDL_CondSignal(autosave->posted);
+		SDL_UnlockMutex(autosave->lock);
+		SDL_WaitThread(autosave->thread, NULL);
+	}
+	if (autosave->posted != NULL)
+		SDL_DestroyCond(autosave->posted);
+	if (autosave->lock != NULL)
+		SDL_DestroyMutex(autosave->lock);
+	free(autosave->queue);
+	memset(autosave, 0, sizeof(Autosave));
+}
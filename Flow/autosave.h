@@ -0,0 +1,44 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include <stdio.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "levelpack.h"
+#include "progress.h"
+
+typedef enum AutosaveEventType
+{
+	ProgressChanged, ScoresChanged
+} AutosaveEventType;
+
+typedef struct AutosaveEvent
+{
+	AutosaveEventType type;
+	int level; //the level, state and best time of ProgressChanged
+	LevelState state;
+	Uint32 timeRecord;
+	int scores[3]; //the time trial high scores of ScoresChanged
+} AutosaveEvent;
+
+//writes the changes posted by the game on its own thread
+typedef struct Autosave
+{
+	ProgressJournal *journal;
+	const char *scoresPath;
+	AutosaveEvent *queue;
+	int queued, queueCapacity, stopping;
+	SDL_mutex *lock; //guards the queue and stopping
+	SDL_cond *posted;
+	SDL_Thread *thread; //NULL if the changes are written right away
+} Autosave;
+
+int SyncFile(FILE *file);
+int ReplaceWithFile(const char *from, const char *to);
+int WriteFileAtomically(const char *path, const char *data, size_t size);
+int StartAutosave(Autosave *autosave, ProgressJournal *journal, const char *scoresPath);
+void PostProgress(Autosave *autosave, int level, LevelState state, Uint32 timeRecord);
+void PostScores(Autosave *autosave, const int *scores);
+void StopAutosave(Autosave *autosave);
+
+#endif
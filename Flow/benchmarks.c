@@ -0,0 +1,213 @@
+#ifdef FLOW_TESTS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmarks.h"
+#include "flowelement.h"
+#include "levelpack.h"
+
+//the flow elements before they became index-linked records, only kept to compare them in BenchFlowElements
+typedef struct LinkedFlowElement
+{
+	struct LinkedFlowElement *prev, *next;
+	SDL_Rect position;
+	FlowElementShape shape;
+} LinkedFlowElement;
+
+/// <summary>
+/// Measures the size of the flow elements of a level and the time to walk its flows, for FlowElement and for the
+/// pointer-linked elements it replaced. The flows fill a 30x30 board in 16 snaking paths, their elements
+/// are handed out a cell of every flow at a time, as routing them would.
+/// FOR_EACH is slower than the pointer walk: a walk is a chain of dependent loads, FOR_EACH loads the next
+/// index after the loads of the body and has to turn it into an address before following it, where the
+/// pointer walk follows next right away. Reading next before the body closes the gap, so that walk is timed too.
+/// </summary>
+/// <returns>Returns -1 if memory ran out, 0 otherwise.</returns>
+int BenchFlowElements()
+{
+	const int size = 30, flowCount = 16, passes = 200000;
+	FlowElement *elements;
+	LinkedFlowElement *linked[30 * 30], *node, *firstLinked[16];
+	Uint16 first[16], last[16], element, next;
+	int lengths[16], cells = size * size, allocated = 0, flow, i, cell, pass, result = 0;
+	Uint32 start, indexTicks, nextFirstTicks, linkedTicks, sum = 0;
+	if ((elements = (FlowElement *)malloc(cells * sizeof(FlowElement))) == NULL)
+		return -1;
+	for (flow = 0; flow < flowCount; flow++)
+	{
+		lengths[flow] = (flow + 1) * cells / flowCount - flow * cells / flowCount;
+		first[flow] = last[flow] = NO_ELEMENT;
+		firstLinked[flow] = NULL;
+	}
+	for (i = 0; i < cells / flowCount + 1; i++)
+	{
+		for (flow = 0; flow < flowCount; flow++)
+		{
+			if (i >= lengths[flow])
+				continue;
+			//the cells of the board in snaking order, right on even rows and left on odd ones
+			cell = flow * cells / flowCount + i;
+			elements[allocated].y = (Uint8)(cell / size);
+			elements[allocated].x = (Uint8)(cell / size % 2 == 0 ? cell % size : size - 1 - cell % size);
+			elements[allocated].shape = (Uint8)(i == 0 ? EndS : RightS | LeftS);
+			elements[allocated].prev = last[flow];
+			elements[allocated].next = NO_ELEMENT;
+			if ((linked[allocated] = (LinkedFlowElement *)malloc(sizeof(LinkedFlowElement))) == NULL)
+				result = -1;
+			else
+			{
+				linked[allocated]->position.x = elements[allocated].x;
+				linked[allocated]->position.y = elements[allocated].y;
+				linked[allocated]->position.w = linked[allocated]->position.h = 0;
+				linked[allocated]->shape = (FlowElementShape)elements[allocated].shape;
+				linked[allocated]->prev = i == 0 ? NULL : linked[last[flow]];
+				linked[allocated]->next = NULL;
+				if (i == 0)
+					firstLinked[flow] = linked[allocated];
+				else if (linked[last[flow]] != NULL)
+					linked[last[flow]]->next = linked[allocated];
+			}
+			if (i == 0)
+				first[flow] = (Uint16)allocated;
+			else
+				elements[last[flow]].next = (Uint16)allocated;
+			last[flow] = (Uint16)allocated++;
+		}
+	}
+	if (result == 0)
+	{
+		start = SDL_GetTicks();
+		for (pass = 0; pass < passes; pass++)
+			for (flow = 0; flow < flowCount; flow++)
+				FOR_EACH(element, first[flow], elements)
+					sum += elements[element].x + elements[element].y + elements[element].shape;
+		indexTicks = SDL_GetTicks() - start;
+		start = SDL_GetTicks();
+		for (pass = 0; pass < passes; pass++)
+		{
+			for (flow = 0; flow < flowCount; flow++)
+			{
+				for (element = first[flow]; element != NO_ELEMENT; element = next)
+				{
+					next = elements[element].next;
+					sum += elements[element].x + elements[element].y + elements[element].shape;
+				}
+			}
+		}
+		nextFirstTicks = SDL_GetTicks() - start;
+		start = SDL_GetTicks();
+		for (pass = 0; pass < passes; pass++)
+			for (flow = 0; flow < flowCount; flow++)
+				for (node = firstLinked[flow]; node != NULL; node = node->next)
+					sum += node->position.x + node->position.y + node->shape;
+		linkedTicks = SDL_GetTicks() - start;
+		printf("FlowElement: %u bytes, %u bytes for a %dx%d level\n", (unsigned)sizeof(FlowElement),
+			(unsigned)(cells * sizeof(FlowElement)), size, size);
+		printf("Pointer-linked element: %u bytes, %u bytes for a %dx%d level and a heap block per element\n",
+			(unsigned)sizeof(LinkedFlowElement), (unsigned)(cells * sizeof(LinkedFlowElement)), size, size);
+		printf("Walking %d elements %d times, ns per element: %.2f linked by index with FOR_EACH, "
+			"%.2f linked by index reading next first, %.2f linked by pointer (%u)\n", cells, passes,
+			indexTicks * 1e6 / ((double)cells * passes), nextFirstTicks * 1e6 / ((double)cells * passes),
+			linkedTicks * 1e6 / ((double)cells * passes), (unsigned)(sum & 1));
+	}
+	for (i = 0; i < allocated; i++)
+		free(linked[i]);
+	free(elements);
+	return result;
+}
+
+/// <summary>
+/// Writes a pack of random playable levels, measures loading it with the parser and opening it as a text pack,
+/// then removes it.
+/// </summary>
+/// <param name="path">The path of the pack to write.</param>
+/// <param name="count">The number of levels.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int BenchLevelLoading(const char *path, int count)
+{
+	LevelPack pack;
+	FILE *file;
+	const Uint8 *endpoints;
+	Uint8 cells[14 * 14], swap;
+	Uint32 seed = 1, start;
+	long length;
+	int i, j, k, size, line, column, playable = 0, result = 0;
+	if ((file = fopen(path, "wt")) == NULL)
+	{
+		printf("Unable to create %s\n", path);
+		return -1;
+	}
+	//sizes 5 to 14 with as many flows, the endpoints are the first cells of a shuffle
+	for (i = 0; i < count; i++)
+	{
+		size = 5 + i % 10;
+		for (j = 0; j < size * size; j++)
+			cells[j] = (Uint8)j;
+		fputc('{', file);
+		for (j = 0; j < size * 2; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			k = j + (int)((seed >> 8) % (Uint32)(size * size - j));
+			swap = cells[j];
+			cells[j] = cells[k];
+			cells[k] = swap;
+			if (j % 2 == 0)
+				fprintf(file, "{%d,%d,", cells[j] % size + 1, cells[j] / size + 1);
+			else
+				fprintf(file, "%d,%d},", cells[j] % size + 1, cells[j] / size + 1);
+		}
+		fprintf(file, "%d,0,0}\n", size);
+	}
+	length = ftell(file);
+	if (fclose(file) != 0 || length <= 0)
+	{
+		printf("Unable to write %s\n", path);
+		remove(path);
+		return -1;
+	}
+	printf("%d levels, %.1f MB of text\n", count, length / 1048576.0);
+	start = SDL_GetTicks();
+	if ((file = fopen(path, "rt")) == NULL || LoadLevelsFromFile(file, &pack, &line, &column) == -1)
+		result = -1;
+	else
+	{
+		printf("Parsed in %lu ms, %.1f MB of levels and endpoints\n", (unsigned long)(SDL_GetTicks() - start),
+			(pack.count * sizeof(LevelDef) + pack.endpointCount) / 1048576.0);
+		FreeLevelPack(&pack);
+	}
+	if (file != NULL)
+		fclose(file);
+	start = SDL_GetTicks();
+	if (result == 0 && OpenTextLevelPack(path, &pack, &line, &column) == 0)
+	{
+		printf("Opened as a text pack in %lu ms\n", (unsigned long)(SDL_GetTicks() - start));
+		start = SDL_GetTicks();
+		for (i = 0; i < pack.count; i++)
+			if (GetPlayableLevel(&pack, i, &endpoints) != NULL)
+				playable++;
+		printf("Decoded %d playable levels page by page in %lu ms\n", playable, (unsigned long)(SDL_GetTicks() - start));
+		FreeLevelPack(&pack);
+	}
+	else
+		result = -1;
+	if (result == -1)
+		printf("Unable to load %s\n", path);
+	remove(path);
+	return result;
+}
+
+/// <summary>
+/// Runs the benchmark named by the arguments of the program.
+/// </summary>
+/// <param name="argc">The number of arguments.</param>
+/// <param name="argv">The arguments.</param>
+/// <returns>Returns the exit code of the benchmark, -1 if the arguments do not name one.</returns>
+int RunBenchmark(int argc, char *argv[])
+{
+	if (argc == 2 && strcmp(argv[1], "--bench-elements") == 0)
+		return BenchFlowElements() == -1 ? 1 : 0;
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench-load") == 0)
+		return BenchLevelLoading(argv[2], argc == 4 ? atoi(argv[3]) : 1000000) == -1 ? 1 : 0;
+	return -1;
+}
+#endif
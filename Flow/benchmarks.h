@@ -0,0 +1,15 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <SDL.h>
+
+//the benchmarks are test code, they are only built with FLOW_TESTS defined:
+//Flow --bench-elements measures the flow elements of a level and Flow --bench-load levels.txt [levels]
+//writes a pack of random levels, 1000000 by default, and measures loading it
+#ifdef FLOW_TESTS
+int BenchFlowElements();
+int BenchLevelLoading(const char *path, int count);
+int RunBenchmark(int argc, char *argv[]);
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <SDL.h>
+
+#define BITBOARD_MAX_SIZE 32
+#define BITBOARD_MAX_WORDS (BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE / 64)
+
+//bit y * size + x stands for the cell (x, y), boards up to 8x8 use only the first word
+typedef struct Bitboard
+{
+	Uint64 words[BITBOARD_MAX_WORDS];
+} Bitboard;
+
+/// <summary>
+/// Counts the set bits of a word.
+/// </summary>
+/// <param name="word">The word.</param>
+/// <returns>Returns the number of set bits.</returns>
+static __inline int PopCount64(Uint64 word)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(word);
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/// <summary>
+/// Gets the index of the lowest set bit of a word.
+/// </summary>
+/// <param name="word">The word, must not be 0.</param>
+/// <returns>Returns the index of the lowest set bit.</returns>
+static __inline int LowestBit64(Uint64 word)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(word);
+#else
+	return PopCount64((word & (0 - word)) - 1);
+#endif
+}
+
+/// <summary>
+/// Gets the number of words used by a board.
+/// </summary>
+/// <param name="size">The size of the board.</param>
+/// <returns>Returns the number of words.</returns>
+static __inline int BitboardWords(int size)
+{
+	return (size * size + 63) / 64;
+}
+
+/// <summary>
+/// Clears every cell of a board.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="words">The number of words used by the board.</param>
+static __inline void BitboardZero(Bitboard *board, int words)
+{
+	int i;
+	for (i = 0; i < words; i++)
+		board->words[i] = 0;
+}
+
+/// <summary>
+/// Adds a cell to a board.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="cell">The index of the cell.</param>
+static __inline void BitboardSet(Bitboard *board, int cell)
+{
+	board->words[cell >> 6] |= (Uint64)1 << (cell & 63);
+}
+
+/// <summary>
+/// Removes a cell from a board.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="cell">The index of the cell.</param>
+static __inline void BitboardClear(Bitboard *board, int cell)
+{
+	board->words[cell >> 6] &= ~((Uint64)1 << (cell & 63));
+}
+
+/// <summary>
+/// Determines whether a cell is on a board.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="cell">The index of the cell.</param>
+/// <returns>Returns 1 if the cell is set, 0 otherwise.</returns>
+static __inline int BitboardTest(const Bitboard *board, int cell)
+{
+	return (int)((board->words[cell >> 6] >> (cell & 63)) & 1);
+}
+
+/// <summary>
+/// Counts the cells of a board.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="words">The number of words used by the board.</param>
+/// <returns>Returns the number of set cells.</returns>
+static __inline int BitboardCount(const Bitboard *board, int words)
+{
+	int i, count = 0;
+	for (i = 0; i < words; i++)
+		count += PopCount64(board->words[i]);
+	return count;
+}
+
+/// <summary>
+/// Determines whether two boards share a cell.
+/// </summary>
+/// <param name="a">A board.</param>
+/// <param name="b">A board.</param>
+/// <param name="words">The number of words used by the boards.</param>
+/// <returns>Returns 1 if the boards intersect, 0 otherwise.</returns>
+static __inline int BitboardIntersects(const Bitboard *a, const Bitboard *b, int words)
+{
+	int i;
+	for (i = 0; i < words; i++)
+		if (a->words[i] & b->words[i])
+			return 1;
+	return 0;
+}
+
+/// <summary>
+/// Adds every cell of a board to another.
+/// </summary>
+/// <param name="to">The board to extend.</param>
+/// <param name="from">The cells to add.</param>
+/// <param name="words">The number of words used by the boards.</param>
+static __inline void BitboardOr(Bitboard *to, const Bitboard *from, int words)
+{
+	int i;
+	for (i = 0; i < words; i++)
+		to->words[i] |= from->words[i];
+}
+
+/// <summary>
+/// Removes every cell of a board from another.
+/// </summary>
+/// <param name="to">The board to shrink.</param>
+/// <param name="from">The cells to remove.</param>
+/// <param name="words">The number of words used by the boards.</param>
+static __inline void BitboardAndNot(Bitboard *to, const Bitboard *from, int words)
+{
+	int i;
+	for (i = 0; i < words; i++)
+		to->words[i] &= ~from->words[i];
+}
+
+/// <summary>
+/// Moves every cell of a board toward higher indices, cells moved past the last word are lost.
+/// </summary>
+/// <param name="to">The moved board, may be the same as from.</param>
+/// <param name="from">The board to move.</param>
+/// <param name="bits">The number of indices to move by, from 1 to 63.</param>
+/// <param name="words">The number of words used by the boards.</param>
+static __inline void BitboardShiftUp(Bitboard *to, const Bitboard *from, int bits, int words)
+{
+	int i;
+	for (i = words - 1; i > 0; i--)
+		to->words[i] = from->words[i] << bits | from->words[i - 1] >> (64 - bits);
+	to->words[0] = from->words[0] << bits;
+}
+
+/// <summary>
+/// Moves every cell of a board toward lower indices, cells moved below 0 are lost.
+/// </summary>
+/// <param name="to">The moved board, may be the same as from.</param>
+/// <param name="from">The board to move.</param>
+/// <param name="bits">The number of indices to move by, from 1 to 63.</param>
+/// <param name="words">The number of words used by the boards.</param>
+static __inline void BitboardShiftDown(Bitboard *to, const Bitboard *from, int bits, int words)
+{
+	int i;
+	for (i = 0; i < words - 1; i++)
+		to->words[i] = from->words[i] >> bits | from->words[i + 1] << (64 - bits);
+	to->words[words - 1] = from->words[words - 1] >> bits;
+}
+
+/// <summary>
+/// Determines whether every cell of a board is set.
+/// </summary>
+/// <param name="board">The board.</param>
+/// <param name="size">The size of the board.</param>
+/// <returns>Returns 1 if the board is full, 0 otherwise.</returns>
+static __inline int BitboardFull(const Bitboard *board, int size)
+{
+	return BitboardCount(board, BitboardWords(size)) == size * size;
+}
+
+#endif
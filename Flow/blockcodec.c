@@ -0,0 +1,170 @@
+#include <string.h>
+#include "blockcodec.h"
+
+/// <summary>
+/// Sets up the probabilities of a coder, every bit is as likely to be 0 as 1.
+/// </summary>
+/// <param name="coder">The coder.</param>
+/// <param name="position">The coded bytes.</param>
+/// <param name="end">The end of the coded bytes.</param>
+void InitBlockCoder(BlockCoder *coder, Uint8 *position, const Uint8 *end)
+{
+	int i;
+	memset(coder, 0, sizeof(BlockCoder));
+	for (i = 0; i < 256; i++)
+		coder->probabilities[i] = 1 << (BLOCKCODEC_PROBABILITY_BITS - 1);
+	coder->range = 0xffffffff;
+	coder->cacheSize = 1;
+	coder->position = position;
+	coder->end = end;
+}
+
+/// <summary>
+/// Writes the top byte of the low end of the range once a carry cannot change it any more.
+/// </summary>
+/// <param name="coder">The coder.</param>
+void ShiftBlockCoder(BlockCoder *coder)
+{
+	Uint8 carry;
+	if ((Uint32)coder->low < 0xff000000u || (coder->low >> 32) != 0)
+	{
+		carry = (Uint8)(coder->low >> 32);
+		//the bytes held back are 0xff but for the first one, a carry turns them into 0
+		do
+		{
+			if (coder->position < coder->end)
+				*coder->position++ = (Uint8)(coder->cache + carry);
+			else
+				coder->overflow = 1;
+			coder->cache = 0xff;
+		} while (--coder->cacheSize != 0);
+		coder->cache = (Uint8)(coder->low >> 24);
+	}
+	coder->cacheSize++;
+	coder->low = (coder->low & 0x00ffffff) << 8;
+}
+
+/// <summary>
+/// Encodes a bit and moves its probability towards it.
+/// </summary>
+/// <param name="coder">The coder.</param>
+/// <param name="probability">The probability of the bit being 0.</param>
+/// <param name="bit">The bit.</param>
+void EncodeBlockBit(BlockCoder *coder, Uint16 *probability, int bit)
+{
+	Uint32 bound = (coder->range >> BLOCKCODEC_PROBABILITY_BITS) * *probability;
+	if (bit == 0)
+	{
+		coder->range = bound;
+		*probability += ((1 << BLOCKCODEC_PROBABILITY_BITS) - *probability) >> BLOCKCODEC_MOVE_BITS;
+	}
+	else
+	{
+		coder->low += bound;
+		coder->range -= bound;
+		*probability -= *probability >> BLOCKCODEC_MOVE_BITS;
+	}
+	while (coder->range < BLOCKCODEC_TOP)
+	{
+		coder->range <<= 8;
+		ShiftBlockCoder(coder);
+	}
+}
+
+/// <summary>
+/// Reads the next coded byte, past the end it reads 0.
+/// </summary>
+/// <param name="coder">The coder.</param>
+/// <returns>Returns the byte.</returns>
+Uint8 ReadBlockCoderByte(BlockCoder *coder)
+{
+	if (coder->position < coder->end)
+		return *coder->position++;
+	coder->overflow = 1;
+	return 0;
+}
+
+/// <summary>
+/// Decodes a bit and moves its probability towards it.
+/// </summary>
+/// <param name="coder">The coder.</param>
+/// <param name="probability">The probability of the bit being 0.</param>
+/// <returns>Returns the bit.</returns>
+int DecodeBlockBit(BlockCoder *coder, Uint16 *probability)
+{
+	Uint32 bound = (coder->range >> BLOCKCODEC_PROBABILITY_BITS) * *probability;
+	int bit;
+	if (coder->code < bound)
+	{
+		coder->range = bound;
+		*probability += ((1 << BLOCKCODEC_PROBABILITY_BITS) - *probability) >> BLOCKCODEC_MOVE_BITS;
+		bit = 0;
+	}
+	else
+	{
+		coder->code -= bound;
+		coder->range -= bound;
+		*probability -= *probability >> BLOCKCODEC_MOVE_BITS;
+		bit = 1;
+	}
+	while (coder->range < BLOCKCODEC_TOP)
+	{
+		coder->range <<= 8;
+		coder->code = coder->code << 8 | ReadBlockCoderByte(coder);
+	}
+	return bit;
+}
+
+/// <summary>
+/// Encodes a block, the block is decoded on its own.
+/// </summary>
+/// <param name="data">The block.</param>
+/// <param name="length">The length of the block.</param>
+/// <param name="coded">The coded block.</param>
+/// <param name="capacity">The room for the coded block.</param>
+/// <returns>Returns the length of the coded block, 0 if it does not fit.</returns>
+size_t EncodeBlock(const Uint8 *data, size_t length, Uint8 *coded, size_t capacity)
+{
+	BlockCoder coder;
+	size_t i;
+	int bit, context;
+	InitBlockCoder(&coder, coded, coded + capacity);
+	for (i = 0; i < length && !coder.overflow; i++)
+	{
+		for (bit = 7, context = 1; bit >= 0; bit--)
+		{
+			EncodeBlockBit(&coder, &coder.probabilities[context], data[i] >> bit & 1);
+			context = context << 1 | (data[i] >> bit & 1);
+		}
+	}
+	//the low end of the range and the bytes held back
+	for (i = 0; i < 5; i++)
+		ShiftBlockCoder(&coder);
+	return coder.overflow ? 0 : coder.position - coded;
+}
+
+/// <summary>
+/// Decodes a block encoded by EncodeBlock.
+/// </summary>
+/// <param name="coded">The coded block.</param>
+/// <param name="codedLength">The length of the coded block.</param>
+/// <param name="data">The block.</param>
+/// <param name="length">The length of the block.</param>
+/// <returns>Returns -1 if the coded block ends too early, 0 otherwise.</returns>
+int DecodeBlock(const Uint8 *coded, size_t codedLength, Uint8 *data, size_t length)
+{
+	BlockCoder coder;
+	size_t i;
+	int bit, context;
+	InitBlockCoder(&coder, (Uint8 *)coded, coded + codedLength);
+	//the first byte is the cache of the encoder, always 0
+	for (i = 0; i < 5; i++)
+		coder.code = coder.code << 8 | ReadBlockCoderByte(&coder);
+	for (i = 0; i < length; i++)
+	{
+		for (bit = 0, context = 1; bit < 8; bit++)
+			context = context << 1 | DecodeBlockBit(&coder, &coder.probabilities[context]);
+		data[i] = (Uint8)context;
+	}
+	return coder.overflow ? -1 : 0;
+}
@@ -0,0 +1,27 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <SDL.h>
+
+#define BLOCKCODEC_PROBABILITY_BITS 11 //the precision of the probability of a bit being 0
+#define BLOCKCODEC_MOVE_BITS 5 //how fast the probabilities follow the bits coded
+#define BLOCKCODEC_TOP (1u << 24) //the range is shifted a byte at a time once it is below this
+
+//an adaptive binary range coder: every byte is coded a bit at a time, highest first,
+//with the bits of the byte coded before it as the context of the bit
+typedef struct BlockCoder
+{
+	Uint16 probabilities[256]; //indexed by a 1 followed by the bits of the byte coded so far
+	Uint64 low; //only used to encode
+	Uint32 range, code; //code is only used to decode
+	Uint8 cache; //the byte held back until a carry cannot reach it any more
+	Uint32 cacheSize;
+	Uint8 *position; //the coded bytes, written or read
+	const Uint8 *end;
+	int overflow; //1 once the coder wrote or read past the end
+} BlockCoder;
+
+size_t EncodeBlock(const Uint8 *data, size_t length, Uint8 *coded, size_t capacity);
+int DecodeBlock(const Uint8 *coded, size_t codedLength, Uint8 *data, size_t length);
+
+#endif
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boardstore.h"
+#include "autosave.h"
+
+/// <summary>
+/// Compares two stored boards by pack and level.
+/// </summary>
+/// <param name="a">The first board.</param>
+/// <param name="b">The second board.</param>
+/// <returns>Returns a negative number, zero or a positive number as for qsort.</returns>
+int CompareStoredBoards(const void *a, const void *b)
+{
+	const StoredBoard *boardA = (const StoredBoard *)a, *boardB = (const StoredBoard *)b;
+	if (boardA->pack != boardB->pack)
+		return boardA->pack < boardB->pack ? -1 : 1;
+	if (boardA->level != boardB->level)
+		return boardA->level < boardB->level ? -1 : 1;
+	return 0;
+}
+
+/// <summary>
+/// Finds the board of a level by binary search.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="level">The index of the level.</param>
+/// <param name="found">Set to 1 if the level has a board, 0 otherwise.</param>
+/// <returns>Returns the index of the board, or where it would be inserted.</returns>
+int FindStoredBoard(const BoardStore *store, const LevelPack *pack, int level, int *found)
+{
+	StoredBoard key;
+	int low = 0, high = store->count, middle, order;
+	key.pack = pack;
+	key.level = level;
+	*found = 0;
+	while (low < high)
+	{
+		middle = (low + high) / 2;
+		if ((order = CompareStoredBoards(&store->boards[middle], &key)) == 0)
+		{
+			*found = 1;
+			return middle;
+		}
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/// <summary>
+/// Reads a stored board and its length, kept as a varint in front of it.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="index">The index of the board.</param>
+/// <param name="length">The length of the board.</param>
+/// <returns>Returns the board.</returns>
+const Uint8 *ReadStoredBoard(const BoardStore *store, int index, int *length)
+{
+	const Uint8 *position = &store->data[store->boards[index].offset];
+	Uint32 value;
+	ReadVarint(&position, store->data + store->used, &value);
+	*length = value;
+	return position;
+}
+
+/// <summary>
+/// Gets the size a stored board takes in the data of the store.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="index">The index of the board.</param>
+/// <returns>Returns the size of the board and its length.</returns>
+Uint32 GetStoredBoardSize(const BoardStore *store, int index)
+{
+	int length;
+	return ReadStoredBoard(store, index, &length) + length - &store->data[store->boards[index].offset];
+}
+
+/// <summary>
+/// Gets the board stored for a level.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="level">The index of the level.</param>
+/// <param name="length">The length of the board.</param>
+/// <returns>Returns the board, or NULL if the level has none. It is valid until the store changes.</returns>
+const Uint8 *GetStoredBoard(const BoardStore *store, const LevelPack *pack, int level, int *length)
+{
+	int index, found;
+	index = FindStoredBoard(store, pack, level, &found);
+	if (!found)
+		return NULL;
+	return ReadStoredBoard(store, index, length);
+}
+
+/// <summary>
+/// Moves the boards to the front of the data, dropping the garbage left by replaced boards.
+/// </summary>
+/// <param name="store">The store.</param>
+void CompactBoardStore(BoardStore *store)
+{
+	Uint8 *data;
+	Uint32 used = 0, size;
+	int i;
+	if ((data = (Uint8 *)malloc(store->dataCapacity)) == NULL)
+		return; //the garbage stays a while longer
+	for (i = 0; i < store->count; i++)
+	{
+		size = GetStoredBoardSize(store, i);
+		memcpy(&data[used], &store->data[store->boards[i].offset], size);
+		store->boards[i].offset = used;
+		used += size;
+	}
+	free(store->data);
+	store->data = data;
+	store->used = used;
+	store->garbage = 0;
+}
+
+/// <summary>
+/// Stores the board of a level, replacing the one stored before.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="level">The index of the level.</param>
+/// <param name="board">The board.</param>
+/// <param name="length">The length of the board, 0 removes the stored board.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int StoreBoard(BoardStore *store, const LevelPack *pack, int level, const Uint8 *board, int length)
+{
+	StoredBoard *boards;
+	const Uint8 *stored;
+	Uint8 *data, *position;
+	Uint32 capacity;
+	int index, found, storedLength;
+	index = FindStoredBoard(store, pack, level, &found);
+	if (found)
+	{
+		stored = ReadStoredBoard(store, index, &storedLength);
+		if (storedLength == length && memcmp(stored, board, length) == 0)
+			return 0;
+	}
+	if (length == 0)
+	{
+		RemoveStoredBoard(store, pack, level);
+		return 0;
+	}
+	if (!found && store->count == store->capacity)
+	{
+		capacity = store->capacity == 0 ? 64 : store->capacity * 2;
+		if ((boards = (StoredBoard *)realloc(store->boards, capacity * sizeof(StoredBoard))) == NULL)
+			return -1;
+		store->boards = boards;
+		store->capacity = capacity;
+	}
+	if (store->garbage > store->used / 2)
+		CompactBoardStore(store);
+	if (store->used + length + 5 > store->dataCapacity)
+	{
+		for (capacity = store->dataCapacity == 0 ? 4096 : store->dataCapacity; capacity < store->used + length + 5;)
+			capacity *= 2;
+		if ((data = (Uint8 *)realloc(store->data, capacity)) == NULL)
+			return -1;
+		store->data = data;
+		store->dataCapacity = capacity;
+	}
+	if (found)
+		store->garbage += GetStoredBoardSize(store, index);
+	else
+	{
+		memmove(&store->boards[index + 1], &store->boards[index], (store->count - index) * sizeof(StoredBoard));
+		store->boards[index].pack = pack;
+		store->boards[index].level = level;
+		store->count++;
+	}
+	store->boards[index].offset = store->used;
+	position = &store->data[store->used];
+	WriteVarint(&position, length);
+	memcpy(position, board, length);
+	store->used = position + length - store->data;
+	return 0;
+}
+
+/// <summary>
+/// Removes the board stored for a level.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="level">The index of the level.</param>
+void RemoveStoredBoard(BoardStore *store, const LevelPack *pack, int level)
+{
+	int index, found;
+	index = FindStoredBoard(store, pack, level, &found);
+	if (!found)
+		return;
+	store->garbage += GetStoredBoardSize(store, index);
+	store->count--;
+	memmove(&store->boards[index], &store->boards[index + 1], (store->count - index) * sizeof(StoredBoard));
+}
+
+/// <summary>
+/// Moves the boards of a pack to the new indices of their levels after the pack was reloaded.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="levels">The new index of every old level, -1 for a level that is gone.
+/// NULL removes every board of the pack.</param>
+/// <param name="count">The number of old levels.</param>
+void MoveStoredBoards(BoardStore *store, const LevelPack *pack, const int *levels, int count)
+{
+	int i, kept = 0;
+	for (i = 0; i < store->count; i++)
+	{
+		if (store->boards[i].pack == pack)
+		{
+			if (levels == NULL || store->boards[i].level >= (Uint32)count || levels[store->boards[i].level] == -1)
+			{
+				store->garbage += GetStoredBoardSize(store, i);
+				continue;
+			}
+			store->boards[i].level = levels[store->boards[i].level];
+		}
+		store->boards[kept++] = store->boards[i];
+	}
+	store->count = kept;
+	if (store->count > 1)
+		qsort(store->boards, store->count, sizeof(StoredBoard), CompareStoredBoards);
+}
+
+/// <summary>
+/// Loads the boards of a pack saved by SaveBoardStore. The boards are checked when they are restored,
+/// so only their lengths and levels are checked here.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="path">The path of the file.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 if the file could not be read, 0 otherwise.</returns>
+int LoadBoardStore(BoardStore *store, const char *path, const LevelPack *pack)
+{
+	BoardStoreHeader header;
+	Uint8 board[BOARDSTORE_MAX_LENGTH];
+	Uint32 entry[2]; //the level and the length
+	FILE *file;
+	int result = 0;
+	if ((file = fopen(path, "rb")) == NULL)
+		return -1;
+	if (fread(&header, sizeof(BoardStoreHeader), 1, file) != 1 ||
+		memcmp(header.magic, BOARDSTORE_MAGIC, 4) != 0 || header.version != BOARDSTORE_VERSION)
+		result = -1;
+	while (result == 0 && fread(entry, sizeof(entry), 1, file) == 1)
+	{
+		if (entry[0] >= (Uint32)pack->count || entry[1] == 0 || entry[1] > BOARDSTORE_MAX_LENGTH ||
+			fread(board, 1, entry[1], file) != entry[1] || StoreBoard(store, pack, entry[0], board, entry[1]) == -1)
+			result = -1;
+	}
+	fclose(file);
+	return result;
+}
+
+/// <summary>
+/// Saves the boards of a pack atomically.
+/// </summary>
+/// <param name="store">The store.</param>
+/// <param name="path">The path of the file.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int SaveBoardStore(const BoardStore *store, const char *path, const LevelPack *pack)
+{
+	BoardStoreHeader header;
+	const Uint8 *board;
+	Uint8 *file, *position;
+	Uint32 entry[2];
+	size_t size = sizeof(BoardStoreHeader);
+	int i, length, result;
+	for (i = 0; i < store->count; i++)
+	{
+		if (store->boards[i].pack != pack)
+			continue;
+		ReadStoredBoard(store, i, &length);
+		size += sizeof(entry) + length;
+	}
+	if ((file = (Uint8 *)malloc(size)) == NULL)
+		return -1;
+	memcpy(header.magic, BOARDSTORE_MAGIC, 4);
+	header.version = BOARDSTORE_VERSION;
+	memcpy(file, &header, sizeof(BoardStoreHeader));
+	position = file + sizeof(BoardStoreHeader);
+	for (i = 0; i < store->count; i++)
+	{
+		if (store->boards[i].pack != pack)
+			continue;
+		board = ReadStoredBoard(store, i, &length);
+		entry[0] = store->boards[i].level;
+		entry[1] = length;
+		memcpy(position, entry, sizeof(entry));
+		memcpy(position + sizeof(entry), board, length);
+		position += sizeof(entry) + length;
+	}
+	result = WriteFileAtomically(path, (const char *)file, size);
+	free(file);
+	return result;
+}
+
+/// <summary>
+/// Frees the store.
+/// </summary>
+/// <param name="store">The store.</param>
+void FreeBoardStore(BoardStore *store)
+{
+	free(store->boards);
+	free(store->data);
+	memset(store, 0, sizeof(BoardStore));
+}
@@ -0,0 +1,43 @@
+#ifndef BOARDSTORE_H
+#define BOARDSTORE_H
+
+#include <SDL.h>
+#include "bitboard.h"
+#include "levelpack.h"
+
+#define BOARDSTORE_MAGIC "FLWB"
+#define BOARDSTORE_VERSION 1
+//a board is a varint per flow and a 2 bit direction code per step, at most a step per cell
+#define BOARDSTORE_MAX_LENGTH (255 * 3 + BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE / 4)
+
+//file layout: the header, then the level, the length and the bytes of every board, stored little-endian
+typedef struct BoardStoreHeader
+{
+	char magic[4];
+	Uint32 version;
+} BoardStoreHeader;
+
+typedef struct StoredBoard
+{
+	const LevelPack *pack;
+	Uint32 level, offset; //the board is at offset in the data of the store, after its length
+} StoredBoard;
+
+//the unfinished boards of the levels, a few dozen bytes each
+typedef struct BoardStore
+{
+	StoredBoard *boards; //sorted by pack and level
+	int count, capacity;
+	Uint8 *data; //the length and the bytes of every board, replaced boards are garbage until compacted
+	Uint32 used, garbage, dataCapacity;
+} BoardStore;
+
+const Uint8 *GetStoredBoard(const BoardStore *store, const LevelPack *pack, int level, int *length);
+int StoreBoard(BoardStore *store, const LevelPack *pack, int level, const Uint8 *board, int length);
+void RemoveStoredBoard(BoardStore *store, const LevelPack *pack, int level);
+void MoveStoredBoards(BoardStore *store, const LevelPack *pack, const int *levels, int count);
+int LoadBoardStore(BoardStore *store, const char *path, const LevelPack *pack);
+int SaveBoardStore(const BoardStore *store, const char *path, const LevelPack *pack);
+void FreeBoardStore(BoardStore *store);
+
+#endif
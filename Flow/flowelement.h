@@ -0,0 +1,27 @@
+#ifndef FLOWELEMENT_H
+#define FLOWELEMENT_H
+
+#include <SDL.h>
+
+#define NO_ELEMENT 0xffff
+#define FOR_EACH(element, first, elements) \
+	for ((element) = (first); (element) != NO_ELEMENT; (element) = (elements)[(element)].next)
+
+typedef enum FlowElementShape
+{
+	None = 0,
+	UpS = (1<<0),
+	RightS = (1<<1),
+	DownS = (1<<2),
+	LeftS = (1<<3),
+	EndS = (1<<4)
+} FlowElementShape;
+
+//a cell of a flow, the elements of a level are one array linked by their index in it
+typedef struct FlowElement
+{
+	Uint16 prev, next;
+	Uint8 x, y, shape;
+} FlowElement;
+
+#endif
@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hintengine.h"
+
+/// <summary>
+/// Determines whether two requests hold the same board.
+/// </summary>
+/// <param name="a">A request.</param>
+/// <param name="b">A request.</param>
+/// <returns>Returns 1 if the boards are the same, 0 otherwise.</returns>
+int IsSameHintRequest(const HintRequest *a, const HintRequest *b)
+{
+	return a->size == b->size && a->flowCount == b->flowCount &&
+		memcmp(a->endpoints, b->endpoints, a->flowCount * 4) == 0 &&
+		memcmp(a->moveStarts, b->moveStarts, (a->flowCount * 2 + 1) * sizeof(Uint16)) == 0 &&
+		memcmp(a->moves, b->moves, a->moveStarts[a->flowCount * 2]) == 0;
+}
+
+/// <summary>
+/// Lays the paths of some flows of a request on the first state of a search.
+/// </summary>
+/// <param name="solver">The solver, set up for the level of the request.</param>
+/// <param name="request">The request.</param>
+/// <param name="flows">The flows whose paths are laid.</param>
+/// <returns>Returns -1 if a path does not fit the board, 0 otherwise.</returns>
+int SeedHintPaths(Solver *solver, const HintRequest *request, Uint64 flows)
+{
+	SolverState *state = &solver->stack[0];
+	int end, i, cell;
+	for (end = 0; end < request->flowCount * 2; end++)
+	{
+		if ((flows & (Uint64)1 << (end >> 1)) == 0)
+			continue;
+		for (i = request->moveStarts[end]; i < request->moveStarts[end + 1]; i++)
+		{
+			if ((state->unfinished & (Uint64)1 << (end >> 1)) == 0 || request->moves[i] > 3)
+				return -1;
+			cell = solver->neighbours[state->ends[end]][request->moves[i]];
+			if (cell == -1 || (cell != state->ends[end ^ 1] && !BitboardTest(&state->free, cell)))
+				return -1;
+			MoveSolverEnd(solver, state, end, request->moves[i]);
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Searches for a solution keeping the paths of some flows of a request, one whose paths never run
+/// next to themselves first, as SolveLevel does.
+/// </summary>
+/// <param name="hints">The hint engine, its requests cancel the search.</param>
+/// <param name="solver">The solver.</param>
+/// <param name="request">The request.</param>
+/// <param name="flows">The flows whose paths are kept.</param>
+/// <param name="solution">The solution, set if one is found.</param>
+/// <returns>Returns 1 if a solution was found, 0 if there is none, -1 if the search gave up, was cancelled or on error.</returns>
+int SearchHint(HintEngine *hints, Solver *solver, const HintRequest *request, Uint64 flows, LevelSolution *solution)
+{
+	LevelDef def;
+	int strict, result = 0;
+	memset(&def, 0, sizeof(LevelDef));
+	def.size = (Uint8)request->size;
+	def.flowCount = (Uint8)request->flowCount;
+	for (strict = 1; strict >= 0 && result == 0; strict--)
+	{
+		if (InitSolver(solver, &def, request->endpoints, HINTENGINE_NODE_LIMIT) == -1)
+			return -1;
+		solver->strict = strict;
+		solver->cancel = &hints->cancelled;
+		result = SeedHintPaths(solver, request, flows) == -1 ? -1 : SearchSolver(solver, 0, solution);
+		FreeSolver(solver);
+	}
+	return result;
+}
+
+/// <summary>
+/// Picks the next segment of a solution on the flow closest to being finished: the cell after the end of
+/// its path grown from the last endpoint if there is one, from the first endpoint otherwise.
+/// </summary>
+/// <param name="request">The request.</param>
+/// <param name="flows">The flows whose paths are in the solution.</param>
+/// <param name="solution">The solution.</param>
+/// <param name="result">The result, HintFound with the segment if a flow is left to finish.</param>
+void FindHintSegment(const HintRequest *request, Uint64 flows, const LevelSolution *solution, HintResult *result)
+{
+	Uint16 path[SOLVER_MAX_CELLS];
+	int steps[4], flow, count, first, last, remaining, best = -1, cell;
+	steps[0] = -request->size;
+	steps[1] = 1;
+	steps[2] = request->size;
+	steps[3] = -1;
+	for (flow = 0; flow < request->flowCount; flow++)
+	{
+		count = 0;
+		for (cell = request->endpoints[flow * 4 + 1] * request->size + request->endpoints[flow * 4];
+			solution->next[cell] != SOLVER_PATH_END; cell += steps[solution->next[cell]])
+			path[count++] = (Uint16)cell;
+		path[count++] = (Uint16)cell;
+		first = last = 0;
+		if (flows & (Uint64)1 << flow)
+		{
+			first = request->moveStarts[flow * 2 + 1] - request->moveStarts[flow * 2];
+			last = request->moveStarts[flow * 2 + 2] - request->moveStarts[flow * 2 + 1];
+		}
+		//a move covers a cell of the path but for the endpoints, the move joining the ends is the last one
+		remaining = count - 1 - first - last;
+		if (remaining <= 0 || (best != -1 && remaining >= best))
+			continue;
+		best = remaining;
+		result->state = HintFound;
+		result->flow = flow;
+		result->from = path[last > 0 ? count - 1 - last : first];
+		result->to = path[last > 0 ? count - 2 - last : first + 1];
+	}
+}
+
+/// <summary>
+/// Finds a hint for a board. The paths of the flows that are in a solution together are kept, the paths of the
+/// other flows are inconsistent and left out, and the hint is the next segment of that solution.
+/// </summary>
+/// <param name="hints">The hint engine, its requests cancel the search.</param>
+/// <param name="solver">The solver.</param>
+/// <param name="request">The request.</param>
+/// <param name="result">The result, HintUnavailable if no solution was found.</param>
+void FindHint(HintEngine *hints, Solver *solver, const HintRequest *request, HintResult *result)
+{
+	LevelSolution solution;
+	Uint64 routed = 0, kept;
+	int i, found, solved = 0;
+	result->state = HintUnavailable;
+	result->inconsistent = 0;
+	for (i = 0; i < request->flowCount; i++)
+		if (request->moveStarts[i * 2 + 2] > request->moveStarts[i * 2])
+			routed |= (Uint64)1 << i;
+	kept = routed;
+	if ((found = SearchHint(hints, solver, request, kept, &solution)) == 0 && routed != 0)
+	{
+		//the paths are added one by one in the order of the flows, a path that leaves no solution is dropped,
+		//a search that finds none leaves the solution of the last one that found one
+		kept = 0;
+		for (i = 0; i < request->flowCount && found != -1; i++)
+		{
+			if ((routed & (Uint64)1 << i) == 0)
+				continue;
+			if ((found = SearchHint(hints, solver, request, kept | (Uint64)1 << i, &solution)) == 1)
+			{
+				kept |= (Uint64)1 << i;
+				solved = 1;
+			}
+		}
+		if (found != -1)
+			found = solved ? 1 : SearchHint(hints, solver, request, kept, &solution);
+	}
+	if (found != 1)
+		return;
+	result->inconsistent = routed & ~kept;
+	FindHintSegment(request, kept, &solution, result);
+}
+
+/// <summary>
+/// Publishes a result of the worker, GetHint reads it without a lock.
+/// </summary>
+/// <param name="hints">The hint engine.</param>
+/// <param name="result">The result.</param>
+void PublishHintResult(HintEngine *hints, const HintResult *result)
+{
+	long published = AtomicLoad(&hints->published);
+	//the last result is seen published before the one before it is written over
+	AtomicFence();
+	hints->results[(published + 1) & 1] = *result;
+	AtomicStore(&hints->published, published + 1);
+}
+
+/// <summary>
+/// Waits for requests and searches for their hints until the hint engine is stopped.
+/// </summary>
+/// <param name="data">The hint engine.</param>
+/// <returns>Returns 0.</returns>
+int HintThread(void *data)
+{
+	HintEngine *hints = (HintEngine *)data;
+	HintRequest *request;
+	HintResult result;
+	Solver *solver;
+	Uint32 generation;
+	//the solver and the request are too large for the stack of a thread
+	request = (HintRequest *)malloc(sizeof(HintRequest));
+	solver = (Solver *)malloc(sizeof(Solver));
+	SDL_LockMutex(hints->lock);
+	while (1)
+	{
+		while (!hints->pending && !hints->stopping)
+			SDL_CondWait(hints->posted, hints->lock);
+		if (hints->stopping)
+			break;
+		if (request != NULL)
+			*request = hints->request;
+		generation = hints->generation;
+		hints->pending = 0;
+		AtomicStore(&hints->cancelled, 0);
+		SDL_UnlockMutex(hints->lock);
+		result.state = HintUnavailable;
+		result.inconsistent = 0;
+		if (request != NULL && solver != NULL)
+			FindHint(hints, solver, request, &result);
+		result.generation = generation;
+		PublishHintResult(hints, &result);
+		SDL_LockMutex(hints->lock);
+	}
+	SDL_UnlockMutex(hints->lock);
+	free(request);
+	free(solver);
+	return 0;
+}
+
+/// <summary>
+/// Starts the thread searching for hints.
+/// </summary>
+/// <param name="hints">The hint engine.</param>
+/// <returns>Returns -1 if there are no hints, 0 otherwise.</returns>
+int StartHintEngine(HintEngine *hints)
+{
+	memset(hints, 0, sizeof(HintEngine));
+	hints->results[0].state = HintUnavailable;
+	if ((hints->lock = SDL_CreateMutex()) == NULL || (hints->posted = SDL_CreateCond()) == NULL ||
+		(hints->thread = SDL_CreateThread(HintThread, hints)) == NULL)
+		return -1;
+	return 0;
+}
+
+/// <summary>
+/// Posts a board to search a hint for, the search of the board before is cancelled.
+/// A board that did not change is not searched again.
+/// </summary>
+/// <param name="hints">The hint engine.</param>
+/// <param name="request">The board.</param>
+void PostHintRequest(HintEngine *hints, const HintRequest *request)
+{
+	if (hints->thread == NULL)
+		return;
+	SDL_LockMutex(hints->lock);
+	if (hints->generation == 0 || !IsSameHintRequest(&hints->request, request))
+	{
+		hints->request = *request;
+		hints->generation++;
+		hints->pending = 1;
+		AtomicStore(&hints->cancelled, 1);
+		SDL_CondSignal(hints->posted);
+	}
+	SDL_UnlockMutex(hints->lock);
+}
+
+/// <summary>
+/// Gets the hint of the last board posted without a lock, HintSearching until the worker publishes it.
+/// It is called by the thread posting the boards.
+/// </summary>
+/// <param name="hints">The hint engine.</param>
+/// <param name="result">The hint.</param>
+void GetHint(HintEngine *hints, HintResult *result)
+{
+	long published;
+	if (hints->thread == NULL)
+	{
+		result->state = HintUnavailable;
+		result->inconsistent = 0;
+		return;
+	}
+	//the copy is read again if the worker published meanwhile, it may be writing over it
+	do
+	{
+		published = AtomicLoad(&hints->published);
+		*result = hints->results[published & 1];
+		AtomicFence();
+	} while (AtomicLoad(&hints->published) != published);
+	if (result->generation != hints->generation)
+	{
+		result->state = HintSearching;
+		result->inconsistent = 0;
+	}
+}
+
+/// <summary>
+/// Cancels the search and stops the hint thread.
+/// </summary>
+/// <param name="hints">The hint engine.</param>
+void StopHintEngine(HintEngine *hints)
+{
+	if (hints->thread != NULL)
+	{
+		SDL_LockMutex(hints->lock);
+		hints->stopping = 1;
+		AtomicStore(&hints->cancelled, 1);
+		SDL_CondSignal(hints->posted);
+		SDL_UnlockMutex(hints->lock);
+		SDL_WaitThread(hints->thread, NULL);
+	}
+	if (hints->posted != NULL)
+		SDL_DestroyCond(hints->posted);
+	if (hints->lock != NULL)
+		SDL_DestroyMutex(hints->lock);
+	memset(hints, 0, sizeof(HintEngine));
+}
@@ -0,0 +1,53 @@
+#ifndef HINTENGINE_H
+#define HINTENGINE_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "atomics.h"
+#include "solver.h"
+
+#define HINTENGINE_NODE_LIMIT 1000000 //the branches of a search for a hint before giving up
+
+typedef enum HintState
+{
+	HintSearching, HintFound, HintUnavailable
+} HintState;
+
+//the paths of a board, the moves grown from every endpoint in the directions of the solver
+typedef struct HintRequest
+{
+	int size, flowCount;
+	Uint8 endpoints[SOLVER_MAX_FLOWS * 4];
+	Uint16 moveStarts[SOLVER_MAX_FLOWS * 2 + 1]; //the first move of every endpoint, the last one ends the moves
+	Uint8 moves[SOLVER_MAX_CELLS]; //the move joining the ends of a completed flow is the last one of its first endpoint
+} HintRequest;
+
+typedef struct HintResult
+{
+	HintState state;
+	Uint64 inconsistent; //the flows whose paths are in no solution together with the paths of the other flows
+	int flow, from, to; //the next segment of HintFound, the cell at the end of a path and the cell to route it to
+	Uint32 generation; //the request the result is for
+} HintResult;
+
+//searches for a hint on its own thread, the search starts over whenever the board changes
+typedef struct HintEngine
+{
+	SDL_Thread *thread; //NULL if there are no hints
+	SDL_mutex *lock; //guards stopping, pending, generation and request, it is only held to copy
+	SDL_cond *posted;
+	int stopping, pending; //pending is 1 until the worker takes the request
+	Uint32 generation; //counts the requests, only the result of the last one is a hint
+	HintRequest request;
+	//the results of the worker are read without a lock: it writes the one not published last, then publishes it
+	HintResult results[2];
+	AtomicInt published; //the number of results published, the last one is results[published & 1]
+	AtomicInt cancelled; //stops the search of the worker, set when a new request is posted
+} HintEngine;
+
+int StartHintEngine(HintEngine *hints);
+void PostHintRequest(HintEngine *hints, const HintRequest *request);
+void GetHint(HintEngine *hints, HintResult *result);
+void StopHintEngine(HintEngine *hints);
+
+#endif
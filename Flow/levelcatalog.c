@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include "levelcatalog.h"
+
+/// <summary>
+/// Gets the number of processors the workers can run on.
+/// </summary>
+/// <returns>Returns the number of processors, at least 1.</returns>
+int GetProcessorCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#endif
+}
+
+/// <summary>
+/// Gets the extension of a level file.
+/// </summary>
+/// <param name="name">The file name.</param>
+/// <returns>Returns ".pack" or ".txt", NULL if the file is not a level pack.</returns>
+const char *GetLevelFileExtension(const char *name)
+{
+	size_t length = strlen(name);
+	if (length > 5 && strcmp(name + length - 5, ".pack") == 0)
+		return name + length - 5;
+	if (length > 4 && strcmp(name + length - 4, ".txt") == 0)
+		return name + length - 4;
+	return NULL;
+}
+
+/// <summary>
+/// Compares two strings for qsort and bsearch.
+/// </summary>
+/// <param name="a">A pointer to a string.</param>
+/// <param name="b">A pointer to a string.</param>
+/// <returns>Returns the order of the strings.</returns>
+int ComparePaths(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/// <summary>
+/// Adds a file of a directory to a list of paths.
+/// </summary>
+/// <param name="paths">The list, grown as needed.</param>
+/// <param name="count">The number of paths.</param>
+/// <param name="capacity">The capacity of the list.</param>
+/// <param name="directory">The directory.</param>
+/// <param name="name">The file name.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int AddLevelFile(char ***paths, int *count, int *capacity, const char *directory, const char *name)
+{
+	char **pathsTemp;
+	if (GetLevelFileExtension(name) == NULL)
+		return 0;
+	if (*count == *capacity)
+	{
+		*capacity = *capacity ? *capacity * 2 : 16;
+		if ((pathsTemp = (char **)realloc(*paths, *capacity * sizeof(char *))) == NULL)
+			return -1;
+		*paths = pathsTemp;
+	}
+	if (((*paths)[*count] = (char *)malloc(strlen(directory) + strlen(name) + 2)) == NULL)
+		return -1;
+	sprintf((*paths)[(*count)++], "%s/%s", directory, name);
+	return 0;
+}
+
+/// <summary>
+/// Lists the level packs of a directory sorted by name, a text pack is left out
+/// if there is a binary pack of the same name.
+/// </summary>
+/// <param name="directory">The directory.</param>
+/// <param name="paths">The paths of the packs, the caller frees them.</param>
+/// <param name="count">The number of packs, 0 if there is no such directory.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ListLevelFiles(const char *directory, char ***paths, int *count)
+{
+	char *binary;
+	const char *extension;
+	int i, kept, capacity = 0, result = 0;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find;
+	char pattern[FILENAME_MAX];
+#else
+	DIR *dir;
+	struct dirent *entry;
+#endif
+	*paths = NULL;
+	*count = 0;
+#ifdef _WIN32
+	if (strlen(directory) + 3 > sizeof(pattern))
+		return -1;
+	sprintf(pattern, "%s/*", directory);
+	if ((find = FindFirstFileA(pattern, &data)) == INVALID_HANDLE_VALUE)
+		return 0;
+	do
+	{
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			result = AddLevelFile(paths, count, &capacity, directory, data.cFileName);
+	} while (result == 0 && FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	if ((dir = opendir(directory)) == NULL)
+		return 0;
+	while (result == 0 && (entry = readdir(dir)) != NULL)
+		result = AddLevelFile(paths, count, &capacity, directory, entry->d_name);
+	closedir(dir);
+#endif
+	if (result == 0)
+	{
+		qsort(*paths, *count, sizeof(char *), ComparePaths);
+		for (i = 0, kept = 0; i < *count; i++)
+		{
+			extension = GetLevelFileExtension((*paths)[i]);
+			if (strcmp(extension, ".txt") == 0 && (binary = (char *)malloc(strlen((*paths)[i]) + 2)) != NULL)
+			{
+				//a binary pack sorts before the text pack of the same name and is always kept
+				sprintf(binary, "%.*s.pack", (int)(extension - (*paths)[i]), (*paths)[i]);
+				if (bsearch(&binary, *paths, kept, sizeof(char *), ComparePaths) != NULL)
+				{
+					free(binary);
+					free((*paths)[i]);
+					continue;
+				}
+				free(binary);
+			}
+			(*paths)[kept++] = (*paths)[i];
+		}
+		*count = kept;
+		return 0;
+	}
+	for (i = 0; i < *count; i++)
+		free((*paths)[i]);
+	free(*paths);
+	*paths = NULL;
+	*count = 0;
+	return -1;
+}
+
+/// <summary>
+/// Opens the packs of a job until there are none left, each worker thread runs this.
+/// </summary>
+/// <param name="data">The job.</param>
+/// <returns>Returns 0.</returns>
+int CatalogWorker(void *data)
+{
+	CatalogJob *job = (CatalogJob *)data;
+	int i, line, column;
+	while (1)
+	{
+		SDL_LockMutex(job->lock);
+		i = job->next++;
+		SDL_UnlockMutex(job->lock);
+		if (i >= job->count)
+			break;
+		if (strcmp(GetLevelFileExtension(job->paths[i]), ".pack") == 0)
+		{
+			if ((job->results[i] = OpenLevelPack(job->paths[i], &job->packs[i])) == -1)
+				printf("Unable to load level pack %s\n", job->paths[i]);
+		}
+		else if ((job->results[i] = OpenTextLevelPack(job->paths[i], &job->packs[i], &line, &column)) == -1)
+		{
+			if (line == 0)
+				printf("Unable to load level pack %s\n", job->paths[i]);
+			else
+				printf("Unable to parse level pack %s at line %d, column %d\n", job->paths[i], line, column);
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Copies the name of a pack without its directory and extension.
+/// </summary>
+/// <param name="path">The path of the pack.</param>
+/// <returns>Returns the name, NULL on error.</returns>
+char *CopyPackName(const char *path)
+{
+	const char *name, *extension;
+	char *copy;
+	name = strrchr(path, '/');
+	name = name != NULL ? name + 1 : path;
+	if ((extension = GetLevelFileExtension(name)) == NULL)
+		extension = name + strlen(name);
+	if ((copy = (char *)malloc(extension - name + 1)) == NULL)
+		return NULL;
+	memcpy(copy, name, extension - name);
+	copy[extension - name] = '\0';
+	return copy;
+}
+
+/// <summary>
+/// Opens the level packs of a directory on a pool of worker threads and merges them
+/// into a catalog after a built-in pack, in the order of their file names.
+/// Packs that cannot be opened are reported and left out.
+/// </summary>
+/// <param name="catalog">The catalog to fill.</param>
+/// <param name="directory">The directory, it does not have to exist.</param>
+/// <param name="builtIn">The first pack of the catalog, it stays owned by the caller.</param>
+/// <param name="builtInName">The name of the built-in pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int LoadLevelCatalog(LevelCatalog *catalog, const char *directory, LevelPack *builtIn, const char *builtInName)
+{
+	CatalogJob job;
+	SDL_Thread *workers[LEVELCATALOG_MAX_WORKERS];
+	int i, workerCount, result = 0;
+	memset(catalog, 0, sizeof(LevelCatalog));
+	memset(&job, 0, sizeof(CatalogJob));
+	if (ListLevelFiles(directory, &job.paths, &job.count) == -1)
+		return -1;
+	if ((job.packs = (LevelPack *)calloc(job.count + 1, sizeof(LevelPack))) == NULL ||
+		(job.results = (int *)malloc((job.count + 1) * sizeof(int))) == NULL ||
+		(catalog->packs = (LevelPack **)malloc((job.count + 1) * sizeof(LevelPack *))) == NULL ||
+		(catalog->names = (char **)calloc(job.count + 1, sizeof(char *))) == NULL ||
+		(catalog->offsets = (int *)malloc((job.count + 2) * sizeof(int))) == NULL ||
+		(catalog->names[0] = CopyPackName(builtInName)) == NULL)
+		result = -1;
+	else
+	{
+		catalog->loaded = job.packs;
+		catalog->loadedCount = job.count;
+		//the main thread is one of the workers, without a lock it is the only one
+		workerCount = GetProcessorCount();
+		if (workerCount > job.count)
+			workerCount = job.count;
+		if (workerCount > LEVELCATALOG_MAX_WORKERS)
+			workerCount = LEVELCATALOG_MAX_WORKERS;
+		job.lock = SDL_CreateMutex();
+		for (i = 0; i < workerCount - 1 && job.lock != NULL; i++)
+			if ((workers[i] = SDL_CreateThread(CatalogWorker, &job)) == NULL)
+				break;
+		workerCount = i;
+		CatalogWorker(&job);
+		for (i = 0; i < workerCount; i++)
+			SDL_WaitThread(workers[i], NULL);
+		if (job.lock != NULL)
+			SDL_DestroyMutex(job.lock);
+		//merge the packs that could be opened
+		catalog->packs[0] = builtIn;
+		catalog->offsets[0] = 0;
+		catalog->count = builtIn->count;
+		catalog->packCount = 1;
+		for (i = 0; i < job.count && result == 0; i++)
+		{
+			if (job.results[i] == -1)
+				continue;
+			if ((catalog->names[catalog->packCount] = CopyPackName(job.paths[i])) == NULL)
+				result = -1;
+			else
+			{
+				catalog->packs[catalog->packCount] = &job.packs[i];
+				catalog->offsets[catalog->packCount++] = catalog->count;
+				catalog->count += job.packs[i].count;
+			}
+		}
+		catalog->offsets[catalog->packCount] = catalog->count;
+	}
+	for (i = 0; i < job.count; i++)
+		free(job.paths[i]);
+	free(job.paths);
+	free(job.results);
+	if (result == -1)
+	{
+		if (catalog->loaded == NULL)
+			free(job.packs);
+		FreeLevelCatalog(catalog);
+	}
+	return result;
+}
+
+/// <summary>
+/// Finds the pack of a level of the catalog.
+/// </summary>
+/// <param name="catalog">The catalog.</param>
+/// <param name="index">The catalog index of the level.</param>
+/// <returns>Returns the index of the last pack starting at or before the level.</returns>
+int FindCatalogPack(const LevelCatalog *catalog, int index)
+{
+	int low = 0, high = catalog->packCount - 1, middle;
+	while (low < high)
+	{
+		middle = (low + high + 1) / 2;
+		if (catalog->offsets[middle] <= index)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+	return low;
+}
+
+/// <summary>
+/// Finds a level of the catalog in its pack.
+/// </summary>
+/// <param name="catalog">The catalog.</param>
+/// <param name="index">The catalog index of the level.</param>
+/// <param name="level">The index of the level in its pack.</param>
+/// <returns>Returns the pack of the level.</returns>
+LevelPack *FindCatalogLevel(const LevelCatalog *catalog, int index, int *level)
+{
+	int pack = FindCatalogPack(catalog, index);
+	*level = index - catalog->offsets[pack];
+	return catalog->packs[pack];
+}
+
+/// <summary>
+/// Gets the catalog index of a level of a pack.
+/// </summary>
+/// <param name="catalog">The catalog.</param>
+/// <param name="pack">The pack.</param>
+/// <param name="level">The index of the level in the pack.</param>
+/// <returns>Returns the catalog index, -1 if the pack is not in the catalog.</returns>
+int GetCatalogIndex(const LevelCatalog *catalog, const LevelPack *pack, int level)
+{
+	int i;
+	for (i = 0; i < catalog->packCount; i++)
+		if (catalog->packs[i] == pack)
+			return catalog->offsets[i] + level;
+	return -1;
+}
+
+/// <summary>
+/// Frees the catalog and the packs it opened.
+/// </summary>
+/// <param name="catalog">The catalog.</param>
+void FreeLevelCatalog(LevelCatalog *catalog)
+{
+	int i;
+	for (i = 0; i < catalog->loadedCount; i++)
+		FreeLevelPack(&catalog->loaded[i]);
+	if (catalog->names != NULL)
+		for (i = 0; i < catalog->loadedCount + 1; i++)
+			free(catalog->names[i]);
+	free(catalog->loaded);
+	free(catalog->packs);
+	free(catalog->names);
+	free(catalog->offsets);
+	memset(catalog, 0, sizeof(LevelCatalog));
+}
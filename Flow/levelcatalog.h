@@ -0,0 +1,38 @@
+#ifndef LEVELCATALOG_H
+#define LEVELCATALOG_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "levelpack.h"
+
+#define LEVELCATALOG_MAX_WORKERS 16
+
+//the level packs of the level select, indexed as if they were one pack
+typedef struct LevelCatalog
+{
+	LevelPack **packs;
+	char **names; //the file names without extension
+	int *offsets; //the catalog index of the first level of each pack
+	int packCount, count;
+	LevelPack *loaded; //the packs opened by the catalog, the built-in pack is not freed
+	int loadedCount;
+} LevelCatalog;
+
+//the packs of a directory, opened by a pool of worker threads
+typedef struct CatalogJob
+{
+	char **paths;
+	LevelPack *packs;
+	int *results;
+	int count, next;
+	SDL_mutex *lock; //guards next
+} CatalogJob;
+
+int GetProcessorCount(void);
+int LoadLevelCatalog(LevelCatalog *catalog, const char *directory, LevelPack *builtIn, const char *builtInName);
+int FindCatalogPack(const LevelCatalog *catalog, int index);
+LevelPack *FindCatalogLevel(const LevelCatalog *catalog, int index, int *level);
+int GetCatalogIndex(const LevelCatalog *catalog, const LevelPack *pack, int level);
+void FreeLevelCatalog(LevelCatalog *catalog);
+
+#endif
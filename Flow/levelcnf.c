@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "levelcnf.h"
+
+/// <summary>
+/// Gets the edge between a cell and its neighbour in a direction.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="cell">The cell.</param>
+/// <param name="direction">The direction, 0 up, 1 right, 2 down and 3 left.</param>
+/// <param name="neighbour">Set to the neighbour.</param>
+/// <returns>Returns the variable of the edge, -1 if the neighbour is outside the board.</returns>
+int GetLevelCnfEdge(const LevelCnf *cnf, int cell, int direction, int *neighbour)
+{
+	int x = cell % cnf->size, y = cell / cnf->size, n = cnf->size;
+	switch (direction)
+	{
+	case 0:
+		*neighbour = cell - n;
+		return y > 0 ? n * (n - 1) + (y - 1) * n + x : -1;
+	case 1:
+		*neighbour = cell + 1;
+		return x < n - 1 ? y * (n - 1) + x : -1;
+	case 2:
+		*neighbour = cell + n;
+		return y < n - 1 ? n * (n - 1) + y * n + x : -1;
+	default:
+		*neighbour = cell - 1;
+		return x > 0 ? y * (n - 1) + x - 1 : -1;
+	}
+}
+
+/// <summary>
+/// Adds a clause.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="literals">The literals, numbered from 1.</param>
+/// <param name="count">The number of literals.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int AddLevelCnfClause(LevelCnf *cnf, const int *literals, int count)
+{
+	int *grown, capacity;
+	if (cnf->used + count + 1 > cnf->capacity)
+	{
+		for (capacity = cnf->capacity == 0 ? 4096 : cnf->capacity; capacity < cnf->used + count + 1;)
+			capacity *= 2;
+		if ((grown = (int *)realloc(cnf->literals, capacity * sizeof(int))) == NULL)
+			return -1;
+		cnf->literals = grown;
+		cnf->capacity = capacity;
+	}
+	memcpy(&cnf->literals[cnf->used], literals, count * sizeof(int));
+	cnf->used += count;
+	cnf->literals[cnf->used++] = 0;
+	cnf->clauseCount++;
+	return 0;
+}
+
+/// <summary>
+/// Adds the clauses of a cell: an endpoint has a single edge and the color of its flow,
+/// any other cell has two edges.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="cell">The cell.</param>
+/// <param name="flow">The flow of the endpoint in the cell, -1 if there is none.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int EncodeLevelCnfCell(LevelCnf *cnf, int cell, int flow)
+{
+	int edges[4], clause[LEVELCNF_MAX_CLAUSE] = { 0 }, count = 0, direction, neighbour, i, j, k, l, result = 0;
+	for (direction = 0; direction < 4; direction++)
+		if ((edges[count] = GetLevelCnfEdge(cnf, cell, direction, &neighbour)) != -1)
+			edges[count++]++;
+	if (flow != -1)
+	{
+		result |= AddLevelCnfClause(cnf, edges, count);
+		for (i = 0; i < count; i++)
+		{
+			for (j = i + 1; j < count; j++)
+			{
+				clause[0] = -edges[i];
+				clause[1] = -edges[j];
+				result |= AddLevelCnfClause(cnf, clause, 2);
+			}
+		}
+		for (i = 0; i < cnf->colorBits; i++)
+		{
+			clause[0] = cnf->edgeCount + cell * cnf->colorBits + i + 1;
+			if ((flow & 1 << i) == 0)
+				clause[0] = -clause[0];
+			result |= AddLevelCnfClause(cnf, clause, 1);
+		}
+		return result;
+	}
+	//at least two edges: any edges but one have one of them, a cell with a single edge has an empty clause
+	for (i = 0; i < count || (count < 2 && i == 0); i++)
+	{
+		for (j = k = 0; j < count; j++)
+			if (j != i)
+				clause[k++] = edges[j];
+		result |= AddLevelCnfClause(cnf, clause, k);
+	}
+	//at most two edges: any three edges have one that is not taken
+	for (i = 0; i < count; i++)
+	{
+		for (j = i + 1; j < count; j++)
+		{
+			for (l = j + 1; l < count; l++)
+			{
+				clause[0] = -edges[i];
+				clause[1] = -edges[j];
+				clause[2] = -edges[l];
+				result |= AddLevelCnfClause(cnf, clause, 3);
+			}
+		}
+	}
+	return result;
+}
+
+/// <summary>
+/// Turns a level into clauses satisfied by its solutions. Every endpoint has one edge and every
+/// other cell two, so the edges make paths between endpoints and loops. An edge joins cells of
+/// the same color, the color of the flow of an endpoint, so a path joins the endpoints of a flow.
+/// Loops of four cells are ruled out, longer ones are ruled out by SolveLevelSat as they turn up.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int EncodeLevelCnf(LevelCnf *cnf, const LevelDef *def, const Uint8 *endpoints)
+{
+	Sint8 flows[SOLVER_MAX_CELLS];
+	int clause[LEVELCNF_MAX_CLAUSE], n = def->size, cell, direction, neighbour, edge, i, result = 0;
+	memset(cnf, 0, sizeof(LevelCnf));
+	cnf->size = n;
+	cnf->flowCount = def->flowCount;
+	cnf->edgeCount = 2 * n * (n - 1);
+	while (1 << cnf->colorBits < def->flowCount)
+		cnf->colorBits++;
+	cnf->variableCount = cnf->edgeCount + n * n * cnf->colorBits;
+	memset(flows, -1, sizeof(flows));
+	for (i = 0; i < def->flowCount * 2; i++)
+		flows[endpoints[i * 2 + 1] * n + endpoints[i * 2]] = (Sint8)(i >> 1);
+	for (cell = 0; cell < n * n; cell++)
+	{
+		result |= EncodeLevelCnfCell(cnf, cell, flows[cell]);
+		//the edges right of and below the cell keep the color, bit by bit
+		for (direction = 1; direction < 3; direction++)
+		{
+			if ((edge = GetLevelCnfEdge(cnf, cell, direction, &neighbour)) == -1)
+				continue;
+			for (i = 0; i < cnf->colorBits; i++)
+			{
+				clause[0] = -(edge + 1);
+				clause[1] = -(cnf->edgeCount + cell * cnf->colorBits + i + 1);
+				clause[2] = cnf->edgeCount + neighbour * cnf->colorBits + i + 1;
+				result |= AddLevelCnfClause(cnf, clause, 3);
+				clause[1] = -clause[1];
+				clause[2] = -clause[2];
+				result |= AddLevelCnfClause(cnf, clause, 3);
+			}
+		}
+		//a square of four cells is not a loop
+		if (cell % n < n - 1 && cell / n < n - 1)
+		{
+			for (direction = 0; direction < 4; direction++)
+			{
+				edge = GetLevelCnfEdge(cnf, direction < 2 ? cell : cell + n + 1, (direction + 1) & 3, &neighbour);
+				clause[direction] = -(edge + 1);
+			}
+			result |= AddLevelCnfClause(cnf, clause, 4);
+		}
+	}
+	if (result == -1)
+		FreeLevelCnf(cnf);
+	return result;
+}
+
+/// <summary>
+/// Writes clauses as a DIMACS file.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <param name="cnf">The clauses.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int WriteLevelCnf(FILE *file, const LevelCnf *cnf)
+{
+	int i;
+	fprintf(file, "c a %dx%d level with %d flows\n", cnf->size, cnf->size, cnf->flowCount);
+	fprintf(file, "c variables 1 to %d are the edges right of every cell, then the edges below every cell,\n",
+		cnf->edgeCount);
+	fprintf(file, "c then %d color bits per cell, the loops of more than four cells are not ruled out\n", cnf->colorBits);
+	fprintf(file, "p cnf %d %d\n", cnf->variableCount, cnf->clauseCount);
+	for (i = 0; i < cnf->used; i++)
+		fprintf(file, cnf->literals[i] == 0 ? "0\n" : "%d ", cnf->literals[i]);
+	return ferror(file) ? -1 : 0;
+}
+
+/// <summary>
+/// Frees the clauses.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+void FreeLevelCnf(LevelCnf *cnf)
+{
+	free(cnf->literals);
+	memset(cnf, 0, sizeof(LevelCnf));
+}
+
+/// <summary>
+/// Reads the paths of the edges satisfying the clauses, or rules out the loops among them.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="sat">The solver, with the values satisfying the clauses.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="solution">The solution, set if there are no loops.</param>
+/// <returns>Returns -1 on error, 0 if loops were ruled out, 1 if the solution was read.</returns>
+int ReadLevelSat(const LevelCnf *cnf, SatSolver *sat, const Uint8 *endpoints, LevelSolution *solution)
+{
+	Uint8 visited[SOLVER_MAX_CELLS];
+	int loop[SOLVER_MAX_CELLS], lengths[SOLVER_MAX_CELLS / 4], flow, first, cell, previous, next, direction, edge, i;
+	int count = 0, loops = 0;
+	memset(visited, 0, sizeof(visited));
+	solution->size = cnf->size;
+	solution->flowCount = cnf->flowCount;
+	for (flow = 0; flow < cnf->flowCount; flow++)
+	{
+		previous = -1;
+		for (cell = endpoints[flow * 4 + 1] * cnf->size + endpoints[flow * 4]; !visited[cell]; cell = next)
+		{
+			visited[cell] = 1;
+			solution->owners[cell] = (Uint8)flow;
+			solution->next[cell] = SOLVER_PATH_END;
+			for (direction = 0; direction < 4; direction++)
+			{
+				edge = GetLevelCnfEdge(cnf, cell, direction, &next);
+				if (edge != -1 && next != previous && GetSatValue(sat, edge))
+					break;
+			}
+			//the last endpoint has no edge but the one it was entered by
+			if (direction == 4)
+				break;
+			solution->next[cell] = (Uint8)direction;
+			previous = cell;
+		}
+	}
+	//the cells left are loops, each one is ruled out by a clause taking one of its edges away,
+	//once they are all read as adding a clause drops the values
+	for (first = 0; first < cnf->size * cnf->size; first++)
+	{
+		if (visited[first])
+			continue;
+		lengths[loops] = 0;
+		previous = -1;
+		cell = first;
+		do
+		{
+			visited[cell] = 1;
+			for (direction = 0; direction < 4; direction++)
+			{
+				edge = GetLevelCnfEdge(cnf, cell, direction, &next);
+				if (edge != -1 && next != previous && GetSatValue(sat, edge))
+					break;
+			}
+			loop[count++] = SAT_LITERAL(edge, 1);
+			lengths[loops]++;
+			previous = cell;
+			cell = next;
+		} while (cell != first);
+		loops++;
+	}
+	for (i = count = 0; i < loops; count += lengths[i++])
+		if (AddSatClause(sat, &loop[count], lengths[i]) == -1)
+			return -1;
+	return loops == 0;
+}
+
+/// <summary>
+/// Encodes a level and adds its clauses to a new SAT solver.
+/// </summary>
+/// <param name="cnf">The clauses, freed with FreeLevelCnf.</param>
+/// <param name="sat">The solver, freed with FreeSatSolver.</param>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <returns>Returns -1 on error, with nothing left to free, 0 otherwise.</returns>
+int LoadLevelSat(LevelCnf *cnf, SatSolver *sat, const LevelDef *def, const Uint8 *endpoints)
+{
+	int clause[LEVELCNF_MAX_CLAUSE], i, count = 0, result = 0;
+	if (EncodeLevelCnf(cnf, def, endpoints) == -1)
+		return -1;
+	if (InitSatSolver(sat, cnf->variableCount) == -1)
+	{
+		FreeLevelCnf(cnf);
+		return -1;
+	}
+	for (i = 0; i < cnf->used && result == 0; i++)
+	{
+		if (cnf->literals[i] != 0)
+			clause[count++] = SAT_LITERAL(abs(cnf->literals[i]) - 1, cnf->literals[i] < 0);
+		else
+		{
+			result = AddSatClause(sat, clause, count);
+			count = 0;
+		}
+	}
+	if (result == -1)
+	{
+		FreeSatSolver(sat);
+		FreeLevelCnf(cnf);
+	}
+	return result;
+}
+
+/// <summary>
+/// Finds a solution of the clauses of a level that fills the whole board, adding clauses
+/// for the loops of the solutions it finds until one has none. The solver keeps what it learnt,
+/// so it goes on from there once more clauses are added.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="sat">The solver, loaded by LoadLevelSat.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="conflictLimit">The number of conflicts before giving up, 0 for no limit.</param>
+/// <param name="solution">The solution, set if one is found.</param>
+/// <returns>Returns 1 if a solution was found, 0 if there is none, -1 if the solver gave up or on error.</returns>
+int FindLevelSat(const LevelCnf *cnf, SatSolver *sat, const Uint8 *endpoints, Uint32 conflictLimit, LevelSolution *solution)
+{
+	int result = 0;
+	while (result == 0 && (result = SolveSat(sat, conflictLimit)) == 1)
+		result = ReadLevelSat(cnf, sat, endpoints, solution);
+	return result;
+}
+
+/// <summary>
+/// Rules out a solution with a clause taking one of its edges away. Every solution has the same
+/// number of edges, so this one is the only solution the clause rules out.
+/// </summary>
+/// <param name="cnf">The clauses.</param>
+/// <param name="sat">The solver.</param>
+/// <param name="solution">The solution.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int RuleOutLevelSolution(const LevelCnf *cnf, SatSolver *sat, const LevelSolution *solution)
+{
+	int edges[SOLVER_MAX_CELLS], cell, next, count = 0;
+	for (cell = 0; cell < cnf->size * cnf->size; cell++)
+		if (solution->next[cell] != SOLVER_PATH_END)
+			edges[count++] = SAT_LITERAL(GetLevelCnfEdge(cnf, cell, solution->next[cell], &next), 1);
+	return AddSatClause(sat, edges, count);
+}
+
+/// <summary>
+/// Finds a solution of a level that fills the whole board with a SAT solver.
+/// </summary>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="conflictLimit">The number of conflicts before giving up, 0 for no limit.</param>
+/// <param name="solution">The solution, set if one is found.</param>
+/// <returns>Returns 1 if a solution was found, 0 if there is none, -1 if the solver gave up or on error.</returns>
+int SolveLevelSat(const LevelDef *def, const Uint8 *endpoints, Uint32 conflictLimit, LevelSolution *solution)
+{
+	LevelCnf cnf;
+	SatSolver sat;
+	int result;
+	if (LoadLevelSat(&cnf, &sat, def, endpoints) == -1)
+		return -1;
+	result = FindLevelSat(&cnf, &sat, endpoints, conflictLimit, solution);
+	FreeSatSolver(&sat);
+	FreeLevelCnf(&cnf);
+	return result;
+}
+
+/// <summary>
+/// Solves every level of a pack with the SAT solver and reports the ones without a solution filling the board.
+/// </summary>
+/// <param name="path">The path of a text or binary pack.</param>
+/// <returns>Returns -1 if the pack could not be read or a level could not be solved, 0 otherwise.</returns>
+int SolveLevelsSat(const char *path)
+{
+	LevelPack pack;
+	LevelSolution solution;
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	Uint32 start;
+	int i, line, column, result, solved = 0;
+	if (OpenLevelPack(path, &pack) == -1 && OpenTextLevelPack(path, &pack, &line, &column) == -1)
+	{
+		printf("Unable to read %s\n", path);
+		return -1;
+	}
+	start = SDL_GetTicks();
+	for (i = 0; i < pack.count; i++)
+	{
+		if ((def = GetPlayableLevel(&pack, i, &endpoints)) == NULL)
+		{
+			printf("Level %d cannot be played\n", i + 1);
+			continue;
+		}
+		if ((result = SolveLevelSat(def, endpoints, LEVELCNF_CONFLICT_LIMIT, &solution)) == 1)
+			solved++;
+		else if (result == 0)
+			printf("Level %d has no solution\n", i + 1);
+		else
+			printf("Gave up on level %d\n", i + 1);
+	}
+	printf("Solved %d of %d levels in %lu ms\n", solved, pack.count, (unsigned long)(SDL_GetTicks() - start));
+	result = solved == pack.count ? 0 : -1;
+	FreeLevelPack(&pack);
+	return result;
+}
+
+/// <summary>
+/// Writes the clauses of a level of a pack as a DIMACS file, for other SAT solvers.
+/// </summary>
+/// <param name="path">The path of a text or binary pack.</param>
+/// <param name="level">The number of the level, from 1.</param>
+/// <param name="to">The path of the DIMACS file.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ExportLevelCnf(const char *path, int level, const char *to)
+{
+	LevelPack pack;
+	LevelCnf cnf;
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	FILE *file;
+	int line, column, result = -1;
+	if (OpenLevelPack(path, &pack) == -1 && OpenTextLevelPack(path, &pack, &line, &column) == -1)
+	{
+		printf("Unable to read %s\n", path);
+		return -1;
+	}
+	if (level < 1 || level > pack.count || (def = GetPlayableLevel(&pack, level - 1, &endpoints)) == NULL)
+		printf("Level %d cannot be played\n", level);
+	else if (EncodeLevelCnf(&cnf, def, endpoints) == 0)
+	{
+		if ((file = fopen(to, "wt")) == NULL)
+			printf("Unable to create %s\n", to);
+		else
+		{
+			result = WriteLevelCnf(file, &cnf);
+			if (fclose(file) != 0)
+				result = -1;
+			if (result == -1)
+				printf("Unable to write %s\n", to);
+		}
+		FreeLevelCnf(&cnf);
+	}
+	FreeLevelPack(&pack);
+	return result;
+}
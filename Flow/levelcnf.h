@@ -0,0 +1,35 @@
+#ifndef LEVELCNF_H
+#define LEVELCNF_H
+
+#include <stdio.h>
+#include <SDL.h>
+#include "levelpack.h"
+#include "satsolver.h"
+#include "solver.h"
+
+#define LEVELCNF_CONFLICT_LIMIT 1000000 //the conflicts allowed on a level of a checked pack before giving up
+#define LEVELCNF_MAX_CLAUSE 4 //the longest clause of the encoding, the edges of a cell
+
+//the clauses of a level as in a DIMACS file: the variables are numbered from 1, a negated variable is negative
+//and every clause ends with 0. The variables are the edges between neighbouring cells, which the paths run
+//along, then the bits of the color of every cell.
+typedef struct LevelCnf
+{
+	int size, flowCount;
+	int edgeCount, colorBits; //the edges right of every cell come first, then the edges below every cell
+	int variableCount, clauseCount;
+	int *literals;
+	int used, capacity;
+} LevelCnf;
+
+int EncodeLevelCnf(LevelCnf *cnf, const LevelDef *def, const Uint8 *endpoints);
+int WriteLevelCnf(FILE *file, const LevelCnf *cnf);
+void FreeLevelCnf(LevelCnf *cnf);
+int LoadLevelSat(LevelCnf *cnf, SatSolver *sat, const LevelDef *def, const Uint8 *endpoints);
+int FindLevelSat(const LevelCnf *cnf, SatSolver *sat, const Uint8 *endpoints, Uint32 conflictLimit, LevelSolution *solution);
+int RuleOutLevelSolution(const LevelCnf *cnf, SatSolver *sat, const LevelSolution *solution);
+int SolveLevelSat(const LevelDef *def, const Uint8 *endpoints, Uint32 conflictLimit, LevelSolution *solution);
+int SolveLevelsSat(const char *path);
+int ExportLevelCnf(const char *path, int level, const char *to);
+
+#endif
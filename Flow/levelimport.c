@@ -0,0 +1,200 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "levelimport.h"
+
+/// <summary>
+/// Adds a row to the grid being read, a grid with a problem keeps counting its rows until it ends.
+/// </summary>
+/// <param name="grid">The grid.</param>
+/// <param name="row">The row without the line break.</param>
+/// <param name="length">The length of the row.</param>
+/// <param name="line">The line of the row.</param>
+void AddGridRow(LevelGrid *grid, const char *row, int length, int line)
+{
+	int i;
+	if (grid->rows == 0)
+	{
+		grid->firstLine = line;
+		grid->size = length;
+		grid->error = NULL;
+	}
+	if (grid->error == NULL)
+	{
+		if (length > BITBOARD_MAX_SIZE || grid->rows == BITBOARD_MAX_SIZE)
+			grid->error = "it is too large";
+		else if (length != grid->size)
+			grid->error = "its rows have different lengths";
+		else
+		{
+			for (i = 0; i < length; i++)
+			{
+				if (!isalnum((unsigned char)row[i]) && row[i] != '.' && row[i] != '-' && row[i] != '_')
+				{
+					grid->error = "it has a character that is neither a color nor an empty cell";
+					break;
+				}
+			}
+			memcpy(grid->cells[grid->rows], row, length);
+		}
+	}
+	grid->rows++;
+}
+
+/// <summary>
+/// Adds a whole grid to a pack as a level, or reports why it cannot be a level.
+/// </summary>
+/// <param name="grid">The grid, it is emptied.</param>
+/// <param name="writer">The writer of the pack.</param>
+/// <param name="imported">The number of imported levels.</param>
+/// <param name="skipped">The number of skipped grids.</param>
+/// <returns>Returns -1 if the pack could not be written, 0 otherwise.</returns>
+int ImportGrid(LevelGrid *grid, LevelPackWriter *writer, int *imported, int *skipped)
+{
+	LevelDef def;
+	Uint8 endpoints[256 * 4];
+	unsigned char colors[256], color;
+	int cells[256][2], counts[256], keys[256], x, y, i, j, key, colorCount = 0;
+	if (grid->rows == 0)
+		return 0;
+	if (grid->error == NULL && grid->rows != grid->size)
+		grid->error = "it is not square";
+	memset(counts, 0, sizeof(counts));
+	for (y = 0; y < grid->rows && grid->error == NULL; y++)
+	{
+		for (x = 0; x < grid->size; x++)
+		{
+			color = (unsigned char)grid->cells[y][x];
+			if (!isalnum(color))
+				continue;
+			if (counts[color] == 0)
+				colors[colorCount++] = color;
+			if (counts[color] < 2)
+				cells[color][counts[color]] = y * grid->size + x;
+			counts[color]++;
+		}
+	}
+	for (i = 0; i < colorCount && grid->error == NULL; i++)
+		if (counts[colors[i]] != 2)
+			grid->error = "a color does not have exactly two endpoints";
+	if (grid->error == NULL && colorCount == 0)
+		grid->error = "it has no colors";
+	if (grid->error != NULL)
+	{
+		printf("Skipped the grid at line %d: %s\n", grid->firstLine, grid->error);
+		(*skipped)++;
+		grid->rows = 0;
+		return 0;
+	}
+	//the game colors the flows in the order of FLOWCOLORS, so the letters of FLOWCOLORS are numbered
+	//first in its order and the other colors follow in reading order; a letter only keeps its color
+	//when the grid uses all the letters before it (R.G gets red and yellow)
+	for (i = 0; i < colorCount; i++)
+	{
+		color = colors[i];
+		key = strchr(LEVELIMPORT_COLORS, toupper(color)) != NULL ?
+			(int)(strchr(LEVELIMPORT_COLORS, toupper(color)) - LEVELIMPORT_COLORS) : (int)strlen(LEVELIMPORT_COLORS);
+		for (j = i; j > 0 && keys[j - 1] > key; j--)
+		{
+			colors[j] = colors[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		colors[j] = color;
+		keys[j] = key;
+	}
+	for (i = 0; i < colorCount; i++)
+	{
+		endpoints[i * 4] = (Uint8)(cells[colors[i]][0] % grid->size);
+		endpoints[i * 4 + 1] = (Uint8)(cells[colors[i]][0] / grid->size);
+		endpoints[i * 4 + 2] = (Uint8)(cells[colors[i]][1] % grid->size);
+		endpoints[i * 4 + 3] = (Uint8)(cells[colors[i]][1] / grid->size);
+	}
+	def.endpoints = 0;
+	def.size = (Uint8)grid->size;
+	def.flowCount = (Uint8)colorCount;
+	def.state = Uncompleted;
+	def.reserved = 0;
+	def.timeRecord = 0;
+	grid->rows = 0;
+	if (WriteCompressedLevel(writer, &def, endpoints) == -1)
+		return -1;
+	(*imported)++;
+	return 0;
+}
+
+/// <summary>
+/// Converts puzzles drawn as ASCII grids to a compressed pack in one pass, reading a line at a time.
+/// Grids are separated by empty lines, each color is a letter or digit at its two endpoints and
+/// '.', '-' or '_' is an empty cell. Grids that cannot be levels are reported and skipped.
+/// </summary>
+/// <param name="from">The grids opened in text mode.</param>
+/// <param name="to">The pack opened in binary mode.</param>
+/// <param name="imported">The number of imported levels.</param>
+/// <param name="skipped">The number of skipped grids.</param>
+/// <returns>Returns -1 if the grids could not be read or the pack could not be written, 0 otherwise.</returns>
+int ImportGridLevels(FILE *from, FILE *to, int *imported, int *skipped)
+{
+	LevelPackWriter writer;
+	LevelGrid grid;
+	char row[BITBOARD_MAX_SIZE + 3]; //a row of the largest grid and its line break
+	int c, length, tooLong, line = 0, result = 0;
+	*imported = *skipped = 0;
+	if (StartLevelPackWriter(&writer, to) == -1)
+		return -1;
+	grid.rows = 0;
+	while (result == 0 && fgets(row, sizeof(row), from) != NULL)
+	{
+		line++;
+		length = (int)strlen(row);
+		//the rest of a line too long for any grid is not kept
+		if ((tooLong = length > 0 && row[length - 1] != '\n' && !feof(from)) != 0)
+			while ((c = fgetc(from)) != EOF && c != '\n');
+		while (length > 0 && isspace((unsigned char)row[length - 1]))
+			length--;
+		if (tooLong)
+			AddGridRow(&grid, row, BITBOARD_MAX_SIZE + 1, line);
+		else if (length > 0)
+			AddGridRow(&grid, row, length, line);
+		else
+			result = ImportGrid(&grid, &writer, imported, skipped);
+	}
+	if (result == 0)
+		result = ImportGrid(&grid, &writer, imported, skipped);
+	if (ferror(from))
+		result = -1;
+	if (FinishLevelPackWriter(&writer) == -1)
+		result = -1;
+	return result;
+}
+
+/// <summary>
+/// Converts a file of ASCII grids to a compressed pack.
+/// </summary>
+/// <param name="from">The path of the grids.</param>
+/// <param name="to">The path of the new pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ImportLevels(const char *from, const char *to)
+{
+	FILE *gridFile, *packFile;
+	int imported, skipped, result;
+	if ((gridFile = fopen(from, "rt")) == NULL)
+	{
+		printf("Unable to open %s\n", from);
+		return -1;
+	}
+	if ((packFile = fopen(to, "wb")) == NULL)
+	{
+		printf("Unable to create %s\n", to);
+		fclose(gridFile);
+		return -1;
+	}
+	result = ImportGridLevels(gridFile, packFile, &imported, &skipped);
+	fclose(gridFile);
+	if (fclose(packFile) != 0)
+		result = -1;
+	if (result == -1)
+		printf("Unable to import %s to %s\n", from, to);
+	else
+		printf("Imported %d levels, skipped %d grids\n", imported, skipped);
+	return result;
+}
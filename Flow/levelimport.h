@@ -0,0 +1,22 @@
+#ifndef LEVELIMPORT_H
+#define LEVELIMPORT_H
+
+#include <stdio.h>
+#include <SDL.h>
+#include "bitboard.h"
+#include "levelpack.h"
+
+#define LEVELIMPORT_COLORS "RYGBCOP" //the letters of FLOWCOLORS in order, their flows are numbered first
+
+//a puzzle grid being read, one letter per endpoint and '.' for an empty cell
+typedef struct LevelGrid
+{
+	char cells[BITBOARD_MAX_SIZE][BITBOARD_MAX_SIZE];
+	int rows, size, firstLine;
+	const char *error; //the first problem of the grid, NULL if it can be imported
+} LevelGrid;
+
+int ImportGridLevels(FILE *from, FILE *to, int *imported, int *skipped);
+int ImportLevels(const char *from, const char *to);
+
+#endif
@@ -0,0 +1,1296 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "bitboard.h"
+#include "blockcodec.h"
+#include "levelpack.h"
+
+//the index records are read in place from the mapped file
+typedef char LevelDefSizeCheck[sizeof(LevelDef) == 12 ? 1 : -1];
+typedef char LevelPackHeaderSizeCheck[sizeof(LevelPackHeader) == 24 ? 1 : -1];
+
+/// <summary>
+/// Maps a whole file to memory copy-on-write, writes to the mapping never reach the file.
+/// </summary>
+/// <param name="path">The path of the file.</param>
+/// <param name="size">The size of the mapping.</param>
+/// <returns>Returns the mapping, or NULL on error.</returns>
+void *MapFile(const char *path, size_t *size)
+{
+	void *mapping;
+#ifdef _WIN32
+	HANDLE file, fileMapping;
+	DWORD sizeHigh;
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+	*size = GetFileSize(file, &sizeHigh);
+	if (*size == 0 || sizeHigh != 0)
+	{
+		CloseHandle(file);
+		return NULL;
+	}
+	fileMapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (fileMapping == NULL)
+		return NULL;
+	mapping = MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(fileMapping); //the view keeps the mapping open
+	return mapping;
+#else
+	struct stat status;
+	int file;
+	if ((file = open(path, O_RDONLY)) == -1)
+		return NULL;
+	if (fstat(file, &status) == -1 || status.st_size == 0)
+	{
+		close(file);
+		return NULL;
+	}
+	*size = (size_t)status.st_size;
+	mapping = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file); //the mapping keeps the file open
+	return mapping == MAP_FAILED ? NULL : mapping;
+#endif
+}
+
+/// <summary>
+/// Unmaps a file mapped by MapFile.
+/// </summary>
+/// <param name="mapping">The mapping.</param>
+/// <param name="size">The size of the mapping.</param>
+void UnmapFile(void *mapping, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+#else
+	munmap(mapping, size);
+#endif
+}
+
+/// <summary>
+/// Frees the levels of a pack.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+void FreeLevelPack(LevelPack *pack)
+{
+	int i;
+	if (pack->mapping != NULL)
+		UnmapFile(pack->mapping, pack->mappingSize);
+	else
+	{
+		free(pack->levels);
+		free(pack->endpoints);
+	}
+	free(pack->offsets);
+	free(pack->block);
+	free(pack->states);
+	free(pack->timeRecords);
+	for (i = 0; i < LEVELPACK_PAGE_CACHE; i++)
+		free(pack->pages[i].endpoints);
+	memset(pack, 0, sizeof(LevelPack));
+}
+
+/// <summary>
+/// Checks whether a level definition can be played.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="def">The level definition.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int CheckLevelDef(const LevelPack *pack, const LevelDef *def)
+{
+	const Uint8 *endpoints;
+	Bitboard used;
+	int i, cell;
+	if (def->endpoints > pack->endpointCount || pack->endpointCount - def->endpoints < def->flowCount * 4u)
+		return -1;
+	endpoints = &pack->endpoints[def->endpoints];
+	if (def->size <= 0 || def->size > BITBOARD_MAX_SIZE || def->size * def->size < def->flowCount * 2 ||
+		def->state > Starred)
+		return -1;
+	//endpoints must be inside the level and must not overlap
+	BitboardZero(&used, BitboardWords(def->size));
+	for (i = 0; i < def->flowCount * 2; i++)
+	{
+		if (endpoints[i * 2] >= def->size || endpoints[i * 2 + 1] >= def->size)
+			return -1;
+		cell = endpoints[i * 2 + 1] * def->size + endpoints[i * 2];
+		if (BitboardTest(&used, cell))
+			return -1;
+		BitboardSet(&used, cell);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Skips the white space at the position of the parser.
+/// </summary>
+/// <param name="parser">The parser.</param>
+void ParserSkipSpace(LevelParser *parser)
+{
+	while (parser->position < parser->end &&
+		(*parser->position == ' ' || *parser->position == '\t' ||
+		*parser->position == '\r' || *parser->position == '\n'))
+	{
+		if (*parser->position == '\n')
+		{
+			parser->line++;
+			parser->lineStart = parser->position + 1;
+		}
+		parser->position++;
+	}
+}
+
+/// <summary>
+/// Reads a character after optional white space.
+/// </summary>
+/// <param name="parser">The parser.</param>
+/// <param name="c">The expected character.</param>
+/// <returns>Returns -1 if the next character is different, 0 otherwise.</returns>
+int ParserExpect(LevelParser *parser, char c)
+{
+	ParserSkipSpace(parser);
+	if (parser->position >= parser->end || *parser->position != c)
+		return -1;
+	parser->position++;
+	return 0;
+}
+
+/// <summary>
+/// Reads a non-negative decimal number after optional white space.
+/// </summary>
+/// <param name="parser">The parser.</param>
+/// <param name="value">The number read.</param>
+/// <returns>Returns -1 if there is no number or it is too big, 0 otherwise.</returns>
+int ParserReadInt(LevelParser *parser, int *value)
+{
+	const char *start;
+	ParserSkipSpace(parser);
+	start = parser->position;
+	*value = 0;
+	while (parser->position < parser->end && *parser->position >= '0' && *parser->position <= '9')
+	{
+		if (*value > 99999999)
+			return -1;
+		*value = *value * 10 + (*parser->position++ - '0');
+	}
+	return parser->position == start ? -1 : 0;
+}
+
+/// <summary>
+/// Makes room in a pack being parsed for one more level and more endpoints.
+/// </summary>
+/// <param name="parser">The parser.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="endpoints">The number of endpoint bytes to make room for.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int GrowLevelPack(LevelParser *parser, LevelPack *pack, Uint32 endpoints)
+{
+	LevelDef *levelsTemp;
+	Uint8 *endpointsTemp;
+	if (pack->count == parser->levelCapacity)
+	{
+		parser->levelCapacity = parser->levelCapacity ? parser->levelCapacity * 2 : 16;
+		if ((levelsTemp = (LevelDef *)realloc(pack->levels, parser->levelCapacity * sizeof(LevelDef))) == NULL)
+			return -1;
+		pack->levels = levelsTemp;
+	}
+	if (pack->endpointCount + endpoints > parser->endpointCapacity)
+	{
+		while (pack->endpointCount + endpoints > parser->endpointCapacity)
+			parser->endpointCapacity = parser->endpointCapacity ? parser->endpointCapacity * 2 : 256;
+		if ((endpointsTemp = (Uint8 *)realloc(pack->endpoints, parser->endpointCapacity)) == NULL)
+			return -1;
+		pack->endpoints = endpointsTemp;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Parses one level after its opening brace and adds it to a pack.
+/// </summary>
+/// <param name="parser">The parser.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ParseLevel(LevelParser *parser, LevelPack *pack)
+{
+	const char *start = parser->position - 1, *flow;
+	int x1, y1, x2, y2, size, state, timeRecord;
+	LevelDef *def;
+	if (GrowLevelPack(parser, pack, 0) == -1)
+		return -1;
+	def = &pack->levels[pack->count];
+	def->endpoints = pack->endpointCount;
+	def->flowCount = 0;
+	def->reserved = 0;
+	do //there are more flows to read
+	{
+		ParserSkipSpace(parser);
+		flow = parser->position;
+		if (ParserExpect(parser, '{') || ParserReadInt(parser, &x1) || ParserExpect(parser, ',') ||
+			ParserReadInt(parser, &y1) || ParserExpect(parser, ',') ||
+			ParserReadInt(parser, &x2) || ParserExpect(parser, ',') ||
+			ParserReadInt(parser, &y2) || ParserExpect(parser, '}') || ParserExpect(parser, ','))
+			return -1;
+		if (def->flowCount == 255 || GrowLevelPack(parser, pack, 4) == -1)
+			return -1;
+		if (x1 < 1 || y1 < 1 || x2 < 1 || y2 < 1 || x1 > 255 || y1 > 255 || x2 > 255 || y2 > 255)
+		{
+			parser->position = flow;
+			return -1;
+		}
+		pack->endpoints[pack->endpointCount++] = x1 - 1;
+		pack->endpoints[pack->endpointCount++] = y1 - 1;
+		pack->endpoints[pack->endpointCount++] = x2 - 1;
+		pack->endpoints[pack->endpointCount++] = y2 - 1;
+		def->flowCount++;
+		ParserSkipSpace(parser);
+	}
+	while (parser->position < parser->end && *parser->position == '{');
+	if (ParserReadInt(parser, &size) || ParserExpect(parser, ',') ||
+		ParserReadInt(parser, &state) || ParserExpect(parser, ',') ||
+		ParserReadInt(parser, &timeRecord) || ParserExpect(parser, '}'))
+		return -1;
+	def->size = size > 255 ? 0 : size;
+	def->state = state > 255 ? 255 : state;
+	def->timeRecord = timeRecord;
+	if (CheckLevelDef(pack, def) == -1)
+	{
+		parser->position = start; //the level is well-formed but not playable
+		return -1;
+	}
+	pack->count++;
+	return 0;
+}
+
+/// <summary>
+/// Parses levels in the {{x,y,x,y},...,size,state,time} format in one pass.
+/// </summary>
+/// <param name="text">The text.</param>
+/// <param name="length">The length of the text.</param>
+/// <param name="pack">The level pack to fill, its levels are NULL on error.</param>
+/// <param name="errorLine">The line of the first bad level on error.</param>
+/// <param name="errorColumn">The column of the error on error.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ParseLevels(const char *text, size_t length, LevelPack *pack, int *errorLine, int *errorColumn)
+{
+	LevelParser parser;
+	memset(pack, 0, sizeof(LevelPack));
+	parser.position = parser.lineStart = text;
+	parser.end = text + length;
+	parser.line = 1;
+	parser.levelCapacity = 0;
+	parser.endpointCapacity = 0;
+	while (1)
+	{
+		//anything between the levels is skipped
+		while (parser.position < parser.end && *parser.position != '{')
+		{
+			if (*parser.position == '\n')
+			{
+				parser.line++;
+				parser.lineStart = parser.position + 1;
+			}
+			parser.position++;
+		}
+		if (parser.position >= parser.end)
+		{
+			if (pack->count > 0)
+				return 0;
+			break; //no levels at all
+		}
+		parser.position++;
+		if (ParseLevel(&parser, pack) == -1)
+			break;
+	}
+	*errorLine = parser.line;
+	*errorColumn = (int)(parser.position - parser.lineStart) + 1;
+	FreeLevelPack(pack);
+	return -1;
+}
+
+/// <summary>
+/// Reads a whole text file, the size is only a hint in text mode.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <param name="length">The length of the text.</param>
+/// <returns>Returns the text, or NULL on error.</returns>
+char *ReadLevelText(FILE *file, size_t *length)
+{
+	char *text, *textTemp;
+	size_t capacity, read;
+	if (fseek(file, 0, SEEK_END) != 0 || (long)(capacity = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+		capacity = 0;
+	capacity += 4096;
+	if ((text = (char *)malloc(capacity)) == NULL)
+		return NULL;
+	*length = 0;
+	while ((read = fread(text + *length, 1, capacity - *length, file)) > 0)
+	{
+		*length += read;
+		if (*length == capacity)
+		{
+			capacity *= 2;
+			if ((textTemp = (char *)realloc(text, capacity)) == NULL)
+			{
+				free(text);
+				return NULL;
+			}
+			text = textTemp;
+		}
+	}
+	return text;
+}
+
+/// <summary>
+/// Loads the levels from file.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <param name="pack">The level pack to fill, its levels are NULL on error.</param>
+/// <param name="errorLine">The line of the error, 0 if the file could not be read.</param>
+/// <param name="errorColumn">The column of the error.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int LoadLevelsFromFile(FILE *file, LevelPack *pack, int *errorLine, int *errorColumn)
+{
+	char *text;
+	size_t length;
+	int result;
+	memset(pack, 0, sizeof(LevelPack));
+	*errorLine = *errorColumn = 0;
+	if ((text = ReadLevelText(file, &length)) == NULL)
+		return -1;
+	result = ParseLevels(text, length, pack, errorLine, errorColumn);
+	free(text);
+	return result;
+}
+
+/// <summary>
+/// Finds a level by the hash of its record.
+/// </summary>
+/// <param name="hashes">The record hashes of the levels.</param>
+/// <param name="count">The number of levels.</param>
+/// <param name="hash">The hash to find.</param>
+/// <param name="hint">The index to look at first.</param>
+/// <returns>Returns the index of the level, or -1 if there is none.</returns>
+int FindLevelHash(const Uint32 *hashes, int count, Uint32 hash, int hint)
+{
+	int i;
+	if (hint >= 0 && hint < count && hashes[hint] == hash)
+		return hint;
+	for (i = 0; i < count; i++)
+		if (hashes[i] == hash)
+			return i;
+	return -1;
+}
+
+/// <summary>
+/// Checks whether two playable levels have the same size and endpoints, levels matched
+/// by their hash are checked before anything is kept for them.
+/// </summary>
+/// <param name="pack">The level pack of the first level.</param>
+/// <param name="index">The index of the first level.</param>
+/// <param name="other">The level pack of the second level.</param>
+/// <param name="otherIndex">The index of the second level.</param>
+/// <returns>Returns 1 if the levels are the same, 0 otherwise.</returns>
+int IsSameLevel(LevelPack *pack, int index, LevelPack *other, int otherIndex)
+{
+	const LevelDef *def, *otherDef;
+	const Uint8 *endpoints, *otherEndpoints;
+	if ((def = GetPlayableLevel(pack, index, &endpoints)) == NULL ||
+		(otherDef = GetPlayableLevel(other, otherIndex, &otherEndpoints)) == NULL)
+		return 0;
+	return def->size == otherDef->size && def->flowCount == otherDef->flowCount &&
+		memcmp(endpoints, otherEndpoints, def->flowCount * 4) == 0;
+}
+
+/// <summary>
+/// Parses levels like ParseLevels, levels whose record text is the same as in a previous
+/// parse are copied from it instead of being parsed again.
+/// </summary>
+/// <param name="text">The text.</param>
+/// <param name="length">The length of the text.</param>
+/// <param name="previous">The levels of the previous parse, may be empty.</param>
+/// <param name="previousHashes">The record hashes of the previous levels.</param>
+/// <param name="pack">The level pack to fill, its levels are NULL on error.</param>
+/// <param name="hashes">The record hashes of the levels, NULL on error.</param>
+/// <param name="errorLine">The line of the first bad level on error.</param>
+/// <param name="errorColumn">The column of the error on error.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ParseChangedLevels(const char *text, size_t length, const LevelPack *previous, const Uint32 *previousHashes,
+	LevelPack *pack, Uint32 **hashes, int *errorLine, int *errorColumn)
+{
+	LevelParser parser;
+	const char *record;
+	Uint32 hash, *hashesTemp;
+	int depth, match, shift = 0, capacity = 0;
+	memset(pack, 0, sizeof(LevelPack));
+	*hashes = NULL;
+	parser.position = parser.lineStart = text;
+	parser.end = text + length;
+	parser.line = 1;
+	parser.levelCapacity = 0;
+	parser.endpointCapacity = 0;
+	while (1)
+	{
+		while (parser.position < parser.end && *parser.position != '{')
+		{
+			if (*parser.position == '\n')
+			{
+				parser.line++;
+				parser.lineStart = parser.position + 1;
+			}
+			parser.position++;
+		}
+		if (parser.position >= parser.end)
+		{
+			if (pack->count > 0)
+				return 0;
+			break; //no levels at all
+		}
+		if (pack->count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 16;
+			if ((hashesTemp = (Uint32 *)realloc(*hashes, capacity * sizeof(Uint32))) == NULL)
+				break;
+			*hashes = hashesTemp;
+		}
+		//FNV-1a over the record up to its closing brace
+		hash = 2166136261u;
+		depth = 0;
+		for (record = parser.position; record < parser.end; record++)
+		{
+			hash = (hash ^ (Uint8)*record) * 16777619u;
+			if (*record == '{')
+				depth++;
+			else if (*record == '}' && --depth == 0)
+				break;
+		}
+		//an unchanged level is most likely as far from its old index as the last one
+		match = record < parser.end ? FindLevelHash(previousHashes, previous->count, hash, pack->count + shift) : -1;
+		if (match >= 0 && GrowLevelPack(&parser, pack, previous->levels[match].flowCount * 4) == 0)
+		{
+			shift = match - pack->count;
+			pack->levels[pack->count] = previous->levels[match];
+			pack->levels[pack->count].endpoints = pack->endpointCount;
+			memcpy(&pack->endpoints[pack->endpointCount], &previous->endpoints[previous->levels[match].endpoints],
+				previous->levels[match].flowCount * 4);
+			pack->endpointCount += previous->levels[match].flowCount * 4;
+			pack->count++;
+			for (; parser.position <= record; parser.position++)
+			{
+				if (*parser.position == '\n')
+				{
+					parser.line++;
+					parser.lineStart = parser.position + 1;
+				}
+			}
+		}
+		else
+		{
+			parser.position++;
+			if (ParseLevel(&parser, pack) == -1)
+				break;
+		}
+		(*hashes)[pack->count - 1] = hash;
+	}
+	*errorLine = parser.line;
+	*errorColumn = (int)(parser.position - parser.lineStart) + 1;
+	FreeLevelPack(pack);
+	free(*hashes);
+	*hashes = NULL;
+	return -1;
+}
+
+/// <summary>
+/// Copies the levels of a parsed pack.
+/// </summary>
+/// <param name="to">The level pack to fill, its levels are NULL on error.</param>
+/// <param name="from">The parsed level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int CopyLevelPack(LevelPack *to, const LevelPack *from)
+{
+	memset(to, 0, sizeof(LevelPack));
+	if ((to->levels = (LevelDef *)malloc(from->count * sizeof(LevelDef) + 1)) == NULL ||
+		(to->endpoints = (Uint8 *)malloc(from->endpointCount + 1)) == NULL)
+	{
+		FreeLevelPack(to);
+		return -1;
+	}
+	memcpy(to->levels, from->levels, from->count * sizeof(LevelDef));
+	memcpy(to->endpoints, from->endpoints, from->endpointCount);
+	to->endpointCount = from->endpointCount;
+	to->count = from->count;
+	return 0;
+}
+
+/// <summary>
+/// Writes the levels of a pack in the {{x,y,x,y},...,size,state,time} format.
+/// </summary>
+/// <param name="file">The file.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int WriteLevelsToFile(FILE *file, LevelPack *pack)
+{
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	int i, j;
+	for (i = 0; i < pack->count; i++)
+	{
+		if ((def = GetPlayableLevel(pack, i, &endpoints)) != NULL)
+		{
+			fprintf(file, "{");
+			for (j = 0; j < def->flowCount; j++)
+			{
+				fprintf(file, "{%d,%d,%d,%d},",
+					endpoints[j * 4] + 1,
+					endpoints[j * 4 + 1] + 1,
+					endpoints[j * 4 + 2] + 1,
+					endpoints[j * 4 + 3] + 1);
+			}
+			fprintf(file, "%d,%d,%u}", def->size, def->state, def->timeRecord);
+		}
+		else
+			continue; //the endpoints of a bad level of a binary pack cannot be trusted
+		if (i < pack->count - 1)
+			fprintf(file, "\n");
+	}
+	return ferror(file) ? -1 : 0;
+}
+
+/// <summary>
+/// Maps a text level file and finds where its levels start, the levels are decoded
+/// a page at a time when they are used.
+/// </summary>
+/// <param name="path">The path of the file.</param>
+/// <param name="pack">The level pack to fill, its levels are NULL on error.</param>
+/// <param name="errorLine">The line of the error, 0 if the file could not be read.</param>
+/// <param name="errorColumn">The column of the error.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int OpenTextLevelPack(const char *path, LevelPack *pack, int *errorLine, int *errorColumn)
+{
+	const char *text, *position, *end, *lineStart;
+	Uint32 *offsetsTemp;
+	int capacity = 0, depth = 0, line = 1;
+	memset(pack, 0, sizeof(LevelPack));
+	*errorLine = *errorColumn = 0;
+	if ((pack->mapping = MapFile(path, &pack->mappingSize)) == NULL)
+		return -1;
+	if (pack->mappingSize > 0xffffffffu)
+	{
+		FreeLevelPack(pack);
+		return -1;
+	}
+	text = lineStart = (const char *)pack->mapping;
+	end = text + pack->mappingSize;
+	//only the braces are looked at here, the rest is checked when a page is decoded
+	for (position = text; position < end; position++)
+	{
+		if (*position == '{')
+		{
+			if (depth == 2)
+				break; //flows do not nest
+			if (depth++ > 0)
+				continue;
+			if (pack->count == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 1024;
+				if ((offsetsTemp = (Uint32 *)realloc(pack->offsets, capacity * sizeof(Uint32))) == NULL)
+				{
+					FreeLevelPack(pack);
+					return -1;
+				}
+				pack->offsets = offsetsTemp;
+			}
+			pack->offsets[pack->count++] = (Uint32)(position - text);
+		}
+		else if (*position == '}' && depth > 0)
+			depth--;
+		else if (*position == '\n')
+		{
+			line++;
+			lineStart = position + 1;
+		}
+	}
+	if (depth == 0 && pack->count > 0)
+	{
+		if ((pack->states = (Uint8 *)calloc(pack->count, 1)) != NULL &&
+			(pack->timeRecords = (Uint32 *)calloc(pack->count, sizeof(Uint32))) != NULL)
+			return 0;
+		line = 0;
+	}
+	*errorLine = line;
+	*errorColumn = (int)(position - lineStart) + 1;
+	FreeLevelPack(pack);
+	return -1;
+}
+
+/// <summary>
+/// Decodes a page of a text pack, levels that cannot be played get the size 0.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="page">The page to fill.</param>
+/// <param name="first">The index of the first level of the page.</param>
+void DecodeLevelPage(LevelPack *pack, LevelPage *page, int first)
+{
+	LevelParser parser;
+	LevelPack decoded;
+	Uint32 endpointCount;
+	int i;
+	//the page is filled by the parser as if it was a pack of its own
+	memset(&decoded, 0, sizeof(LevelPack));
+	decoded.levels = page->levels;
+	decoded.endpoints = page->endpoints;
+	parser.levelCapacity = LEVELPACK_PAGE_SIZE;
+	parser.endpointCapacity = page->endpointCapacity;
+	for (i = first; i < pack->count && i < first + LEVELPACK_PAGE_SIZE; i++)
+	{
+		parser.position = parser.lineStart = (const char *)pack->mapping + pack->offsets[i] + 1;
+		parser.end = (const char *)pack->mapping + (i < pack->count - 1 ? pack->offsets[i + 1] : pack->mappingSize);
+		parser.line = 1;
+		endpointCount = decoded.endpointCount;
+		if (ParseLevel(&parser, &decoded) == -1)
+		{
+			decoded.endpointCount = endpointCount;
+			memset(&decoded.levels[decoded.count++], 0, sizeof(LevelDef));
+		}
+		if (pack->states[i] != 0)
+			decoded.levels[decoded.count - 1].state = pack->states[i] - 1;
+		if (pack->timeRecords[i] != 0)
+			decoded.levels[decoded.count - 1].timeRecord = pack->timeRecords[i];
+	}
+	page->endpoints = decoded.endpoints;
+	page->endpointCapacity = parser.endpointCapacity;
+	page->first = first;
+	page->count = decoded.count;
+}
+
+/// <summary>
+/// Gets the number of bits an endpoint of a level takes in a compressed pack, endpoints
+/// are stored as the index of their cell.
+/// </summary>
+/// <param name="size">The size of the level.</param>
+/// <returns>Returns the number of bits.</returns>
+int GetCellWidth(int size)
+{
+	int width = 1;
+	while ((1 << width) < size * size)
+		width++;
+	return width;
+}
+
+/// <summary>
+/// Gets the most bytes the levels of a block of a compressed pack can take.
+/// </summary>
+/// <returns>Returns the number of bytes.</returns>
+int GetMaxBlockLength()
+{
+	//a level takes at most three varints of 5 bytes and its endpoints
+	return LEVELPACK_BLOCK_SIZE * (15 + (255 * 2 * GetCellWidth(BITBOARD_MAX_SIZE) + 7) / 8);
+}
+
+/// <summary>
+/// Reads a varint of a compressed pack, 7 bits a byte with the lowest bits first.
+/// </summary>
+/// <param name="position">The position, moved past the varint.</param>
+/// <param name="end">The end of the data.</param>
+/// <param name="value">The value.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ReadVarint(const Uint8 **position, const Uint8 *end, Uint32 *value)
+{
+	int shift;
+	*value = 0;
+	for (shift = 0; shift < 35 && *position < end; shift += 7)
+	{
+		*value |= (Uint32)(**position & 0x7f) << shift;
+		if (*(*position)++ < 0x80)
+			return 0;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Writes a varint of a compressed pack.
+/// </summary>
+/// <param name="position">The position, moved past the varint.</param>
+/// <param name="value">The value.</param>
+void WriteVarint(Uint8 **position, Uint32 value)
+{
+	while (value >= 0x80)
+	{
+		*(*position)++ = (Uint8)(value | 0x80);
+		value >>= 7;
+	}
+	*(*position)++ = (Uint8)value;
+}
+
+/// <summary>
+/// Reads the header of a level of a compressed block: the zigzag coded change of the size
+/// from the previous level of the block shifted left by 3 bits over a best time flag and the state,
+/// the flow count, and the best time if the flag is set. The endpoints follow at the cell width of the size.
+/// </summary>
+/// <param name="position">The position, moved past the header.</param>
+/// <param name="end">The end of the block.</param>
+/// <param name="def">The size of the previous level (0 for the first one), then the level.</param>
+/// <returns>Returns the number of endpoint bytes that follow, -1 on error.</returns>
+int ReadBlockLevelHeader(const Uint8 **position, const Uint8 *end, LevelDef *def)
+{
+	Uint32 delta, flowCount, timeRecord = 0;
+	int size;
+	if (ReadVarint(position, end, &delta) == -1 || ReadVarint(position, end, &flowCount) == -1 ||
+		delta > BITBOARD_MAX_SIZE * 16 || flowCount > 255 ||
+		((delta & 4) && ReadVarint(position, end, &timeRecord) == -1))
+		return -1;
+	def->state = delta & 3;
+	delta >>= 3;
+	size = def->size + (delta & 1 ? -(int)(delta >> 1) - 1 : (int)(delta >> 1));
+	if (size <= 0 || size > BITBOARD_MAX_SIZE)
+		return -1;
+	def->size = size;
+	def->flowCount = flowCount;
+	def->timeRecord = timeRecord;
+	return (def->flowCount * 2 * GetCellWidth(size) + 7) / 8;
+}
+
+/// <summary>
+/// Gets the levels of a block of a compressed pack, a range coded block is decoded
+/// once and kept until another one is needed.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="block">The index of the block.</param>
+/// <param name="end">The end of the levels.</param>
+/// <returns>Returns the levels, NULL if the block cannot be read.</returns>
+const Uint8 *GetBlockLevels(LevelPack *pack, int block, const Uint8 **end)
+{
+	const Uint8 *position;
+	Uint32 length;
+	position = (const Uint8 *)pack->mapping + ((LevelPackHeader *)pack->mapping)->endpointsOffset;
+	*end = position + pack->offsets[block + 1];
+	position += pack->offsets[block];
+	if (pack->compressed == LEVELPACK_STORED_VERSION)
+		return position;
+	if (position == *end)
+		return NULL;
+	if (*position == BlockStored)
+		return position + 1;
+	if (pack->blockIndex == block)
+	{
+		*end = pack->block + pack->blockLength;
+		return pack->block;
+	}
+	position++;
+	if (pack->block == NULL && (pack->block = (Uint8 *)malloc(GetMaxBlockLength())) == NULL)
+		return NULL;
+	pack->blockIndex = -1;
+	if (position[-1] != BlockCoded || ReadVarint(&position, *end, &length) == -1 ||
+		length > (Uint32)GetMaxBlockLength() || DecodeBlock(position, *end - position, pack->block, length) == -1)
+		return NULL;
+	pack->blockIndex = block;
+	pack->blockLength = length;
+	*end = pack->block + length;
+	return pack->block;
+}
+
+/// <summary>
+/// Decodes a page of a compressed pack, levels that cannot be played get the size 0.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="page">The page to fill.</param>
+/// <param name="first">The index of the first level of the page.</param>
+void DecodeBlockPage(LevelPack *pack, LevelPage *page, int first)
+{
+	LevelParser parser; //only its capacities are used
+	LevelPack decoded;
+	LevelDef def;
+	const Uint8 *position, *end;
+	Uint32 bits, cell;
+	int i, j, length, width, bitCount, block = first / LEVELPACK_BLOCK_SIZE;
+	memset(&decoded, 0, sizeof(LevelPack));
+	decoded.levels = page->levels;
+	decoded.endpoints = page->endpoints;
+	parser.levelCapacity = LEVELPACK_PAGE_SIZE;
+	parser.endpointCapacity = page->endpointCapacity;
+	position = GetBlockLevels(pack, block, &end);
+	def.size = 0;
+	//the levels of the block before the page are only skipped
+	for (i = block * LEVELPACK_BLOCK_SIZE; i < first && position != NULL; i++)
+	{
+		if ((length = ReadBlockLevelHeader(&position, end, &def)) == -1 || end - position < length)
+			position = NULL; //the rest of the block cannot be read
+		else
+			position += length;
+	}
+	for (i = first; i < pack->count && i < first + LEVELPACK_PAGE_SIZE; i++)
+	{
+		if (position == NULL || (length = ReadBlockLevelHeader(&position, end, &def)) == -1 ||
+			end - position < length || GrowLevelPack(&parser, &decoded, def.flowCount * 4) == -1)
+		{
+			position = NULL;
+			memset(&decoded.levels[decoded.count++], 0, sizeof(LevelDef));
+		}
+		else
+		{
+			width = GetCellWidth(def.size);
+			bits = 0;
+			bitCount = 0;
+			for (j = 0; j < def.flowCount * 2; j++)
+			{
+				while (bitCount < width)
+				{
+					bits |= (Uint32)*position++ << bitCount;
+					bitCount += 8;
+				}
+				cell = bits & ((1 << width) - 1);
+				decoded.endpoints[decoded.endpointCount + j * 2] = (Uint8)(cell % def.size);
+				decoded.endpoints[decoded.endpointCount + j * 2 + 1] = (Uint8)(cell / def.size);
+				bits >>= width;
+				bitCount -= width;
+			}
+			def.endpoints = decoded.endpointCount;
+			def.reserved = 0;
+			decoded.levels[decoded.count] = def;
+			decoded.endpointCount += def.flowCount * 4;
+			if (CheckLevelDef(&decoded, &def) == -1)
+			{
+				decoded.endpointCount = def.endpoints;
+				memset(&decoded.levels[decoded.count], 0, sizeof(LevelDef));
+			}
+			decoded.count++;
+		}
+		if (pack->states[i] != 0)
+			decoded.levels[decoded.count - 1].state = pack->states[i] - 1;
+		if (pack->timeRecords[i] != 0)
+			decoded.levels[decoded.count - 1].timeRecord = pack->timeRecords[i];
+	}
+	page->endpoints = decoded.endpoints;
+	page->endpointCapacity = parser.endpointCapacity;
+	page->first = first;
+	page->count = decoded.count;
+}
+
+/// <summary>
+/// Gets the decoded page of a text or compressed pack holding a level.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="index">The index of the level.</param>
+/// <returns>Returns the page.</returns>
+LevelPage *GetLevelPage(LevelPack *pack, int index)
+{
+	LevelPage *page = &pack->pages[0];
+	int i, first = index - index % LEVELPACK_PAGE_SIZE;
+	for (i = 0; i < LEVELPACK_PAGE_CACHE; i++)
+	{
+		if (pack->pages[i].count > 0 && pack->pages[i].first == first)
+		{
+			page = &pack->pages[i];
+			break;
+		}
+		if (pack->pages[i].lastUse < page->lastUse)
+			page = &pack->pages[i];
+	}
+	if (i == LEVELPACK_PAGE_CACHE && pack->compressed)
+		DecodeBlockPage(pack, page, first); //the least recently used page is replaced
+	else if (i == LEVELPACK_PAGE_CACHE)
+		DecodeLevelPage(pack, page, first);
+	page->lastUse = ++pack->pageClock;
+	return page;
+}
+
+/// <summary>
+/// Gets a level of a pack, the definition of a text or compressed pack level is only valid until
+/// another page is decoded.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="index">The index of the level.</param>
+/// <returns>Returns the level definition.</returns>
+LevelDef *GetLevelDef(LevelPack *pack, int index)
+{
+	LevelPage *page;
+	if (pack->offsets == NULL)
+		return &pack->levels[index];
+	page = GetLevelPage(pack, index);
+	return &page->levels[index - page->first];
+}
+
+/// <summary>
+/// Gets a level of a pack that can be played.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="index">The index of the level.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <returns>Returns the level definition, or NULL if the level cannot be played.</returns>
+const LevelDef *GetPlayableLevel(LevelPack *pack, int index, const Uint8 **endpoints)
+{
+	LevelPage *page;
+	const LevelDef *def;
+	if (pack->offsets == NULL)
+	{
+		def = &pack->levels[index];
+		if (CheckLevelDef(pack, def) == -1) //levels of binary packs are only checked when played
+			return NULL;
+		*endpoints = &pack->endpoints[def->endpoints];
+		return def;
+	}
+	page = GetLevelPage(pack, index);
+	def = &page->levels[index - page->first];
+	if (def->size == 0) //checked when the page was decoded
+		return NULL;
+	*endpoints = &page->endpoints[def->endpoints];
+	return def;
+}
+
+/// <summary>
+/// Sets the state and the best time of a level, paged packs keep them aside so they
+/// survive the page being decoded again.
+/// </summary>
+/// <param name="pack">The level pack.</param>
+/// <param name="index">The index of the level.</param>
+/// <param name="state">The new state.</param>
+/// <param name="timeRecord">The new best time.</param>
+void SetLevelProgress(LevelPack *pack, int index, LevelState state, Uint32 timeRecord)
+{
+	int i;
+	if (pack->offsets == NULL)
+	{
+		pack->levels[index].state = state;
+		pack->levels[index].timeRecord = timeRecord;
+		return;
+	}
+	pack->states[index] = state + 1;
+	pack->timeRecords[index] = timeRecord;
+	//a decoded page is updated in place, other pages pick the change up when decoded
+	for (i = 0; i < LEVELPACK_PAGE_CACHE; i++)
+	{
+		if (pack->pages[i].count > 0 && index >= pack->pages[i].first &&
+			index < pack->pages[i].first + pack->pages[i].count)
+		{
+			pack->pages[i].levels[index - pack->pages[i].first].state = state;
+			pack->pages[i].levels[index - pack->pages[i].first].timeRecord = timeRecord;
+		}
+	}
+}
+
+/// <summary>
+/// Checks the block index of a mapped compressed pack and keeps a copy of it,
+/// the levels are decoded a page at a time when they are used.
+/// </summary>
+/// <param name="pack">The level pack with the mapped file.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int OpenCompressedLevelPack(LevelPack *pack)
+{
+	LevelPackHeader *header = (LevelPackHeader *)pack->mapping;
+	const Uint32 *index;
+	int i, blockCount;
+	if (header->count == 0 || header->count > 0x7fffffff - LEVELPACK_BLOCK_SIZE)
+		return -1;
+	blockCount = (header->count + LEVELPACK_BLOCK_SIZE - 1) / LEVELPACK_BLOCK_SIZE;
+	if (header->indexOffset % 4 != 0 || header->indexOffset > pack->mappingSize ||
+		(pack->mappingSize - header->indexOffset) / sizeof(Uint32) < (Uint32)blockCount + 1 ||
+		header->endpointsOffset > pack->mappingSize ||
+		pack->mappingSize - header->endpointsOffset < header->endpointCount)
+		return -1;
+	index = (const Uint32 *)((Uint8 *)pack->mapping + header->indexOffset);
+	for (i = 0; i < blockCount; i++)
+		if (index[i] > index[i + 1])
+			return -1;
+	if (index[blockCount] > header->endpointCount)
+		return -1;
+	if ((pack->offsets = (Uint32 *)malloc((blockCount + 1) * sizeof(Uint32))) == NULL ||
+		(pack->states = (Uint8 *)calloc(header->count, 1)) == NULL ||
+		(pack->timeRecords = (Uint32 *)calloc(header->count, sizeof(Uint32))) == NULL)
+		return -1;
+	memcpy(pack->offsets, index, (blockCount + 1) * sizeof(Uint32));
+	pack->count = header->count;
+	pack->compressed = header->version;
+	pack->blockIndex = -1;
+	return 0;
+}
+
+/// <summary>
+/// Maps a binary or compressed level pack, the levels are read in place or decoded when they are used.
+/// </summary>
+/// <param name="path">The path of the pack.</param>
+/// <param name="pack">The level pack to fill, its levels are NULL on error.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int OpenLevelPack(const char *path, LevelPack *pack)
+{
+	LevelPackHeader *header;
+	memset(pack, 0, sizeof(LevelPack));
+	if ((pack->mapping = MapFile(path, &pack->mappingSize)) == NULL)
+		return -1;
+	header = (LevelPackHeader *)pack->mapping;
+	if (pack->mappingSize >= sizeof(LevelPackHeader) && memcmp(header->magic, LEVELPACK_MAGIC, 4) == 0 &&
+		(header->version == LEVELPACK_COMPRESSED_VERSION || header->version == LEVELPACK_STORED_VERSION))
+	{
+		if (OpenCompressedLevelPack(pack) == 0)
+			return 0;
+		FreeLevelPack(pack);
+		return -1;
+	}
+	//only the layout is checked here, each level is checked when it is played
+	if (pack->mappingSize < sizeof(LevelPackHeader) ||
+		memcmp(header->magic, LEVELPACK_MAGIC, 4) != 0 || header->version != LEVELPACK_VERSION ||
+		header->count == 0 || header->indexOffset % 4 != 0 ||
+		header->indexOffset > pack->mappingSize ||
+		(pack->mappingSize - header->indexOffset) / sizeof(LevelDef) < header->count ||
+		header->endpointsOffset > pack->mappingSize ||
+		pack->mappingSize - header->endpointsOffset < header->endpointCount)
+	{
+		FreeLevelPack(pack);
+		return -1;
+	}
+	pack->levels = (LevelDef *)((Uint8 *)pack->mapping + header->indexOffset);
+	pack->endpoints = (Uint8 *)pack->mapping + header->endpointsOffset;
+	pack->endpointCount = header->endpointCount;
+	pack->count = header->count;
+	return 0;
+}
+
+/// <summary>
+/// Writes the levels of a pack in the binary format.
+/// </summary>
+/// <param name="file">The file opened in binary mode.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int WriteLevelPack(FILE *file, const LevelPack *pack)
+{
+	LevelPackHeader header;
+	memcpy(header.magic, LEVELPACK_MAGIC, 4);
+	header.version = LEVELPACK_VERSION;
+	header.count = pack->count;
+	header.indexOffset = sizeof(LevelPackHeader);
+	header.endpointsOffset = header.indexOffset + pack->count * sizeof(LevelDef);
+	header.endpointCount = pack->endpointCount;
+	if (fwrite(&header, sizeof(LevelPackHeader), 1, file) != 1 ||
+		fwrite(pack->levels, sizeof(LevelDef), pack->count, file) != (size_t)pack->count ||
+		fwrite(pack->endpoints, 1, pack->endpointCount, file) != pack->endpointCount)
+		return -1;
+	return 0;
+}
+
+/// <summary>
+/// Starts writing a compressed pack: blocks of LEVELPACK_BLOCK_SIZE levels, each level a header
+/// of varints (see ReadBlockLevelHeader) and the cells of its endpoints packed at the fewest bits
+/// the size of the level needs, range coded if that makes the block smaller, then the index of the blocks.
+/// </summary>
+/// <param name="writer">The writer.</param>
+/// <param name="file">The file opened in binary mode.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int StartLevelPackWriter(LevelPackWriter *writer, FILE *file)
+{
+	memset(writer, 0, sizeof(LevelPackWriter));
+	writer->file = file;
+	memcpy(writer->header.magic, LEVELPACK_MAGIC, 4);
+	writer->header.version = LEVELPACK_COMPRESSED_VERSION;
+	writer->header.endpointsOffset = sizeof(LevelPackHeader);
+	writer->offsetCapacity = 16;
+	if ((writer->block = (Uint8 *)malloc(GetMaxBlockLength())) == NULL ||
+		(writer->coded = (Uint8 *)malloc(GetMaxBlockLength())) == NULL ||
+		(writer->offsets = (Uint32 *)malloc(writer->offsetCapacity * sizeof(Uint32))) == NULL ||
+		fwrite(&writer->header, sizeof(LevelPackHeader), 1, file) != 1)
+	{
+		free(writer->block);
+		free(writer->coded);
+		free(writer->offsets);
+		memset(writer, 0, sizeof(LevelPackWriter));
+		return -1;
+	}
+	writer->offsets[0] = 0;
+	writer->position = writer->block;
+	return 0;
+}
+
+/// <summary>
+/// Writes the block being filled and adds it to the index.
+/// </summary>
+/// <param name="writer">The writer.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int FlushLevelBlock(LevelPackWriter *writer)
+{
+	Uint32 *offsetsTemp;
+	Uint8 method[6], *position = method + 1;
+	size_t length = writer->position - writer->block, codedLength;
+	if (writer->blockCount + 2 > writer->offsetCapacity)
+	{
+		if ((offsetsTemp = (Uint32 *)realloc(writer->offsets, writer->offsetCapacity * 2 * sizeof(Uint32))) == NULL)
+			return -1;
+		writer->offsets = offsetsTemp;
+		writer->offsetCapacity *= 2;
+	}
+	WriteVarint(&position, (Uint32)length);
+	//the block is stored as it is unless coding it saves a byte
+	codedLength = length <= (size_t)(position - method) ? 0 :
+		EncodeBlock(writer->block, length, writer->coded, length - (position - method));
+	method[0] = codedLength > 0 ? BlockCoded : BlockStored;
+	if (codedLength == 0)
+		position = method + 1;
+	if (fwrite(method, 1, position - method, writer->file) != (size_t)(position - method) ||
+		(codedLength > 0 && fwrite(writer->coded, 1, codedLength, writer->file) != codedLength) ||
+		(codedLength == 0 && fwrite(writer->block, 1, length, writer->file) != length))
+		return -1;
+	length = codedLength > 0 ? (position - method) + codedLength : 1 + length;
+	writer->offsets[writer->blockCount + 1] = writer->offsets[writer->blockCount] + (Uint32)length;
+	writer->blockCount++;
+	writer->position = writer->block;
+	return 0;
+}
+
+/// <summary>
+/// Adds a level to a compressed pack.
+/// </summary>
+/// <param name="writer">The writer.</param>
+/// <param name="def">The level, its size must be from 1 to BITBOARD_MAX_SIZE and its endpoints inside it.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <returns>Returns -1 if the pack could not be written, 0 otherwise.</returns>
+int WriteCompressedLevel(LevelPackWriter *writer, const LevelDef *def, const Uint8 *endpoints)
+{
+	Uint32 bits;
+	int i, width, bitCount, delta;
+	if (writer->result == -1)
+		return -1;
+	if (writer->header.count % LEVELPACK_BLOCK_SIZE == 0)
+		writer->previousSize = 0;
+	delta = def->size - writer->previousSize;
+	WriteVarint(&writer->position, (delta >= 0 ? delta * 2 : -delta * 2 - 1) << 3 |
+		(def->timeRecord != 0) << 2 | def->state);
+	WriteVarint(&writer->position, def->flowCount);
+	if (def->timeRecord != 0)
+		WriteVarint(&writer->position, def->timeRecord);
+	writer->previousSize = def->size;
+	width = GetCellWidth(def->size);
+	bits = 0;
+	bitCount = 0;
+	for (i = 0; i < def->flowCount * 2; i++)
+	{
+		bits |= (Uint32)(endpoints[i * 2 + 1] * def->size + endpoints[i * 2]) << bitCount;
+		for (bitCount += width; bitCount >= 8; bitCount -= 8)
+		{
+			*writer->position++ = (Uint8)bits;
+			bits >>= 8;
+		}
+	}
+	if (bitCount > 0)
+		*writer->position++ = (Uint8)bits;
+	if (++writer->header.count % LEVELPACK_BLOCK_SIZE == 0 && FlushLevelBlock(writer) == -1)
+		writer->result = -1;
+	return writer->result;
+}
+
+/// <summary>
+/// Writes the last block and the index of a compressed pack and frees the writer.
+/// </summary>
+/// <param name="writer">The writer.</param>
+/// <returns>Returns -1 if the pack could not be written, 0 otherwise.</returns>
+int FinishLevelPackWriter(LevelPackWriter *writer)
+{
+	LevelPackHeader *header = &writer->header;
+	Uint8 padding[4] = {0};
+	Uint32 paddingLength;
+	if (writer->result == 0 && writer->position != writer->block && FlushLevelBlock(writer) == -1)
+		writer->result = -1;
+	if (writer->result == 0)
+	{
+		header->endpointCount = writer->offsets[writer->blockCount];
+		header->indexOffset = (header->endpointsOffset + header->endpointCount + 3) & ~3u;
+		paddingLength = header->indexOffset - header->endpointsOffset - header->endpointCount;
+		if (fwrite(padding, 1, paddingLength, writer->file) != paddingLength ||
+			fwrite(writer->offsets, sizeof(Uint32), writer->blockCount + 1, writer->file) !=
+			(size_t)writer->blockCount + 1 ||
+			fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(header, sizeof(LevelPackHeader), 1, writer->file) != 1)
+			writer->result = -1;
+	}
+	free(writer->block);
+	free(writer->coded);
+	free(writer->offsets);
+	writer->block = NULL;
+	writer->coded = NULL;
+	writer->offsets = NULL;
+	return writer->result;
+}
+
+/// <summary>
+/// Writes the playable levels of a pack in the compressed format.
+/// </summary>
+/// <param name="file">The file opened in binary mode.</param>
+/// <param name="pack">The level pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int WriteCompressedLevelPack(FILE *file, LevelPack *pack)
+{
+	LevelPackWriter writer;
+	LevelDef unplayable;
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	static const Uint8 overlapping[4] = {0};
+	int i;
+	if (StartLevelPackWriter(&writer, file) == -1)
+		return -1;
+	//a level that cannot be played keeps its place, progress and boards are kept by index,
+	//it becomes a level of size 1 with a flow whose endpoints overlap so it still cannot be played
+	memset(&unplayable, 0, sizeof(LevelDef));
+	unplayable.size = 1;
+	unplayable.flowCount = 1;
+	for (i = 0; i < pack->count; i++)
+	{
+		if ((def = GetPlayableLevel(pack, i, &endpoints)) == NULL)
+		{
+			printf("Level %d cannot be played, it is written as an empty level\n", i + 1);
+			def = &unplayable;
+			endpoints = overlapping;
+		}
+		WriteCompressedLevel(&writer, def, endpoints);
+	}
+	return FinishLevelPackWriter(&writer);
+}
+
+/// <summary>
+/// Converts a text level file to a binary or compressed pack, or a pack back to text
+/// or to a compressed pack.
+/// </summary>
+/// <param name="from">The path of the file to convert.</param>
+/// <param name="to">The path of the new file.</param>
+/// <param name="compress">Whether the new file is a compressed pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int ConvertLevels(const char *from, const char *to, int compress)
+{
+	LevelPack pack;
+	FILE *file;
+	int line, column, result, binary;
+	if ((binary = OpenLevelPack(from, &pack)) == -1)
+	{
+		if ((file = fopen(from, "rt")) == NULL)
+		{
+			printf("Unable to open %s\n", from);
+			return -1;
+		}
+		result = LoadLevelsFromFile(file, &pack, &line, &column);
+		fclose(file);
+		if (result == -1)
+		{
+			printf("Unable to parse %s at line %d, column %d\n", from, line, column);
+			return -1;
+		}
+	}
+	if ((file = fopen(to, binary == -1 || compress ? "wb" : "wt")) == NULL)
+	{
+		printf("Unable to create %s\n", to);
+		FreeLevelPack(&pack);
+		return -1;
+	}
+	if (compress)
+		result = WriteCompressedLevelPack(file, &pack);
+	else
+		result = binary == -1 ? WriteLevelPack(file, &pack) : WriteLevelsToFile(file, &pack);
+	if (fclose(file) != 0)
+		result = -1;
+	if (result == -1)
+		printf("Unable to write %s\n", to);
+	FreeLevelPack(&pack);
+	return result;
+}
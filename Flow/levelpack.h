@@ -0,0 +1,116 @@
+#ifndef LEVELPACK_H
+#define LEVELPACK_H
+
+#include <stdio.h>
+#include <SDL.h>
+
+#define LEVELPACK_MAGIC "FLWP"
+#define LEVELPACK_VERSION 1
+#define LEVELPACK_COMPRESSED_VERSION 3
+#define LEVELPACK_STORED_VERSION 2 //compressed packs whose blocks are not range coded, still read
+#define LEVELPACK_PAGE_SIZE 9 //the levels on one page of the level select menu
+#define LEVELPACK_PAGE_CACHE 4 //the visible page, its neighbours and the page of the current level
+#define LEVELPACK_BLOCK_SIZE (LEVELPACK_PAGE_SIZE * 8) //the levels of a block of a compressed pack, pages never span two blocks
+
+typedef enum LevelState
+{
+	Uncompleted, Completed, Starred
+} LevelState;
+
+//also the record of the level index in binary packs, stored in the byte order of the machine that wrote
+//the pack (little-endian on x86 and ARM) since the records are read in place from the mapped file
+typedef struct LevelDef
+{
+	Uint32 endpoints; //offset of the first flow in the endpoints of the pack
+	Uint8 size, flowCount, state, reserved; //state is a LevelState
+	Uint32 timeRecord;
+} LevelDef;
+
+//levels decoded from a page of a text or compressed pack
+typedef struct LevelPage
+{
+	int first, count, lastUse; //count is 0 for an empty slot
+	LevelDef levels[LEVELPACK_PAGE_SIZE]; //size is 0 for levels that cannot be played
+	Uint8 *endpoints;
+	Uint32 endpointCapacity;
+} LevelPage;
+
+typedef struct LevelPack
+{
+	LevelDef *levels; //NULL for text packs, use GetLevelDef
+	Uint8 *endpoints; //x1, y1, x2, y2 of every flow, counted from 0
+	Uint32 endpointCount;
+	int count;
+	void *mapping; //the mapped file the levels are read from, NULL for parsed packs
+	size_t mappingSize;
+	//text and compressed packs keep the file mapped and only decode the pages that are used
+	Uint32 *offsets; //the opening brace of every level in the text, or the start of every block and the end of the last one
+	int compressed; //the version of a compressed pack, 0 for other packs
+	Uint8 *block; //the last block of a compressed pack that was range coded, once decoded
+	int blockIndex, blockLength; //blockIndex is -1 if no block was decoded
+	Uint8 *states; //0 for the state in the text, the state + 1 once it is set while playing
+	Uint32 *timeRecords; //0 for the time in the text
+	LevelPage pages[LEVELPACK_PAGE_CACHE];
+	int pageClock;
+} LevelPack;
+
+//binary pack layout: the header, count LevelDef records at indexOffset,
+//then endpointCount endpoint bytes at endpointsOffset;
+//compressed packs have blockCount + 1 block offsets at indexOffset, relative to the
+//endpointCount bytes of blocks at endpointsOffset, each one a method byte: BlockStored and the levels,
+//or BlockCoded, the length of the levels as a varint and the levels range coded by EncodeBlock
+typedef struct LevelPackHeader
+{
+	char magic[4];
+	Uint32 version, count, indexOffset, endpointsOffset, endpointCount;
+} LevelPackHeader;
+
+typedef enum BlockMethod
+{
+	BlockStored, BlockCoded
+} BlockMethod;
+
+//writes a compressed pack a level at a time, only the block index grows with the pack
+typedef struct LevelPackWriter
+{
+	FILE *file;
+	LevelPackHeader header; //count is the number of levels written
+	Uint8 *block, *position; //the block being filled
+	Uint8 *coded; //the block being written, range coded
+	Uint32 *offsets;
+	int blockCount, offsetCapacity, previousSize, result;
+} LevelPackWriter;
+
+typedef struct LevelParser
+{
+	const char *position, *end, *lineStart;
+	int line, levelCapacity;
+	Uint32 endpointCapacity;
+} LevelParser;
+
+void FreeLevelPack(LevelPack *pack);
+int CheckLevelDef(const LevelPack *pack, const LevelDef *def);
+int ParseLevels(const char *text, size_t length, LevelPack *pack, int *errorLine, int *errorColumn);
+char *ReadLevelText(FILE *file, size_t *length);
+int LoadLevelsFromFile(FILE *file, LevelPack *pack, int *errorLine, int *errorColumn);
+int FindLevelHash(const Uint32 *hashes, int count, Uint32 hash, int hint);
+int IsSameLevel(LevelPack *pack, int index, LevelPack *other, int otherIndex);
+int ParseChangedLevels(const char *text, size_t length, const LevelPack *previous, const Uint32 *previousHashes,
+	LevelPack *pack, Uint32 **hashes, int *errorLine, int *errorColumn);
+int CopyLevelPack(LevelPack *to, const LevelPack *from);
+int WriteLevelsToFile(FILE *file, LevelPack *pack);
+int OpenTextLevelPack(const char *path, LevelPack *pack, int *errorLine, int *errorColumn);
+LevelDef *GetLevelDef(LevelPack *pack, int index);
+const LevelDef *GetPlayableLevel(LevelPack *pack, int index, const Uint8 **endpoints);
+void SetLevelProgress(LevelPack *pack, int index, LevelState state, Uint32 timeRecord);
+int OpenLevelPack(const char *path, LevelPack *pack);
+int WriteLevelPack(FILE *file, const LevelPack *pack);
+int ReadVarint(const Uint8 **position, const Uint8 *end, Uint32 *value);
+void WriteVarint(Uint8 **position, Uint32 value);
+int StartLevelPackWriter(LevelPackWriter *writer, FILE *file);
+int WriteCompressedLevel(LevelPackWriter *writer, const LevelDef *def, const Uint8 *endpoints);
+int FinishLevelPackWriter(LevelPackWriter *writer);
+int WriteCompressedLevelPack(FILE *file, LevelPack *pack);
+int ConvertLevels(const char *from, const char *to, int compress);
+
+#endif
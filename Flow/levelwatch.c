@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include "levelwatch.h"
+
+/// <summary>
+/// Parses the watched file and publishes the result, a file saved without changes is not published.
+/// </summary>
+/// <param name="watch">The watch.</param>
+void ReloadWatchedLevels(LevelWatch *watch)
+{
+	LevelPack pack, copy;
+	Uint32 *hashes = NULL, *hashesCopy;
+	FILE *file;
+	char *text = NULL;
+	size_t length;
+	int result = -1, line = 0, column = 0;
+	memset(&pack, 0, sizeof(LevelPack));
+	if ((file = fopen(watch->path, "rt")) != NULL)
+	{
+		text = ReadLevelText(file, &length);
+		fclose(file);
+	}
+	if (text != NULL)
+	{
+		result = ParseChangedLevels(text, length, &watch->previous, watch->previousHashes,
+			&pack, &hashes, &line, &column);
+		free(text);
+	}
+	if (result == 0)
+	{
+		if (watch->result == 0 && pack.count == watch->previous.count &&
+			memcmp(hashes, watch->previousHashes, pack.count * sizeof(Uint32)) == 0)
+		{
+			FreeLevelPack(&pack);
+			free(hashes);
+			return;
+		}
+		//the game takes the published levels, the watch keeps a copy to compare against
+		hashesCopy = (Uint32 *)malloc(pack.count * sizeof(Uint32));
+		if (hashesCopy != NULL && CopyLevelPack(&copy, &pack) == 0)
+		{
+			memcpy(hashesCopy, hashes, pack.count * sizeof(Uint32));
+			FreeLevelPack(&watch->previous);
+			free(watch->previousHashes);
+			watch->previous = copy;
+			watch->previousHashes = hashesCopy;
+		}
+		else
+			free(hashesCopy); //the next parse compares against older levels
+	}
+	SDL_LockMutex(watch->lock);
+	if (watch->published) //replaced before the game took it
+	{
+		FreeLevelPack(&watch->pack);
+		free(watch->hashes);
+	}
+	watch->published = 1;
+	watch->result = result;
+	watch->pack = pack;
+	watch->hashes = hashes;
+	watch->errorLine = line;
+	watch->errorColumn = column;
+	SDL_UnlockMutex(watch->lock);
+}
+
+/// <summary>
+/// Waits a while for the watched file to change.
+/// </summary>
+/// <param name="watch">The watch.</param>
+/// <param name="last">The status of the file when it was last checked.</param>
+/// <returns>Returns 1 if the file changed, 0 otherwise.</returns>
+int WaitForLevelChange(LevelWatch *watch, struct stat *last)
+{
+	struct stat status;
+	int changed = 0;
+#ifdef __linux__
+	Uint64 events[512]; //aligned for struct inotify_event
+	const struct inotify_event *event;
+	struct pollfd descriptor;
+	const char *name;
+	ssize_t length, offset;
+	if (watch->inotify != -1)
+	{
+		descriptor.fd = watch->inotify;
+		descriptor.events = POLLIN;
+		if (poll(&descriptor, 1, LEVELWATCH_INTERVAL) <= 0 ||
+			(length = read(watch->inotify, events, sizeof(events))) <= 0)
+			return 0;
+		name = strrchr(watch->path, '/');
+		name = name != NULL ? name + 1 : watch->path;
+		for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len)
+		{
+			event = (const struct inotify_event *)((char *)events + offset);
+			if (event->len > 0 && strcmp(event->name, name) == 0)
+				changed = 1;
+		}
+		return changed;
+	}
+#endif
+	SDL_Delay(LEVELWATCH_INTERVAL);
+	if (stat(watch->path, &status) == -1)
+		memset(&status, 0, sizeof(status)); //a missing file is a change too
+	changed = status.st_mtime != last->st_mtime || status.st_size != last->st_size;
+	*last = status;
+	return changed;
+}
+
+/// <summary>
+/// Parses the watched file once and again whenever it changes, until the watch is stopped.
+/// </summary>
+/// <param name="data">The watch.</param>
+/// <returns>Returns 0.</returns>
+int LevelWatchThread(void *data)
+{
+	LevelWatch *watch = (LevelWatch *)data;
+	struct stat last;
+	int stopping = 0;
+	if (stat(watch->path, &last) == -1)
+		memset(&last, 0, sizeof(last));
+	ReloadWatchedLevels(watch);
+	while (!stopping)
+	{
+		if (WaitForLevelChange(watch, &last))
+			ReloadWatchedLevels(watch);
+		SDL_LockMutex(watch->lock);
+		stopping = watch->stopping;
+		SDL_UnlockMutex(watch->lock);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Starts watching a level file, with inotify where there is one and by polling its status otherwise.
+/// </summary>
+/// <param name="watch">The watch.</param>
+/// <param name="path">The path of the file.</param>
+/// <returns>Returns -1 if the file was only parsed once, 0 otherwise.</returns>
+int StartLevelWatch(LevelWatch *watch, const char *path)
+{
+#ifdef __linux__
+	char directory[FILENAME_MAX];
+	const char *name;
+#endif
+	memset(watch, 0, sizeof(LevelWatch));
+	watch->path = path;
+	watch->result = -1;
+	watch->inotify = -1;
+#ifdef __linux__
+	//editors often save by replacing the file, so its directory is watched
+	name = strrchr(path, '/');
+	if (name == NULL)
+		strcpy(directory, ".");
+	else if (name == path)
+		strcpy(directory, "/");
+	else if (name - path < (int)sizeof(directory))
+	{
+		memcpy(directory, path, name - path);
+		directory[name - path] = '\0';
+	}
+	else
+		directory[0] = '\0'; //polled
+	if ((watch->inotify = inotify_init()) != -1 && (directory[0] == '\0' ||
+		inotify_add_watch(watch->inotify, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) == -1))
+	{
+		close(watch->inotify);
+		watch->inotify = -1;
+	}
+#endif
+	if ((watch->lock = SDL_CreateMutex()) == NULL ||
+		(watch->thread = SDL_CreateThread(LevelWatchThread, watch)) == NULL)
+	{
+		ReloadWatchedLevels(watch);
+		return -1;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Takes the latest result of the watch.
+/// </summary>
+/// <param name="watch">The watch.</param>
+/// <param name="pack">The new levels, the caller frees them.</param>
+/// <param name="hashes">The record hashes of the new levels, the caller frees them.</param>
+/// <param name="errorLine">The line of the error, 0 if the file could not be read.</param>
+/// <param name="errorColumn">The column of the error.</param>
+/// <returns>Returns 1 for new levels, -1 for a new error and 0 if nothing changed.</returns>
+int TakeWatchedLevels(LevelWatch *watch, LevelPack *pack, Uint32 **hashes, int *errorLine, int *errorColumn)
+{
+	int result = 0;
+	SDL_LockMutex(watch->lock);
+	if (watch->published)
+	{
+		*pack = watch->pack;
+		*hashes = watch->hashes;
+		*errorLine = watch->errorLine;
+		*errorColumn = watch->errorColumn;
+		memset(&watch->pack, 0, sizeof(LevelPack));
+		watch->hashes = NULL;
+		watch->published = 0;
+		result = watch->result == 0 ? 1 : -1;
+	}
+	SDL_UnlockMutex(watch->lock);
+	return result;
+}
+
+/// <summary>
+/// Stops watching and frees the levels not taken.
+/// </summary>
+/// <param name="watch">The watch.</param>
+void StopLevelWatch(LevelWatch *watch)
+{
+	if (watch->thread != NULL)
+	{
+		SDL_LockMutex(watch->lock);
+		watch->stopping = 1;
+		SDL_UnlockMutex(watch->lock);
+		SDL_WaitThread(watch->thread, NULL);
+	}
+#ifdef __linux__
+	if (watch->inotify != -1)
+		close(watch->inotify);
+#endif
+	if (watch->lock != NULL)
+		SDL_DestroyMutex(watch->lock);
+	FreeLevelPack(&watch->pack);
+	free(watch->hashes);
+	FreeLevelPack(&watch->previous);
+	free(watch->previousHashes);
+	memset(watch, 0, sizeof(LevelWatch));
+}
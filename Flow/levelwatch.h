@@ -0,0 +1,31 @@
+#ifndef LEVELWATCH_H
+#define LEVELWATCH_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "levelpack.h"
+
+#define LEVELWATCH_INTERVAL 250 //milliseconds between checks for a change or for stopping
+
+//reparses a level file on its own thread whenever it changes
+typedef struct LevelWatch
+{
+	const char *path;
+	SDL_Thread *thread;
+	SDL_mutex *lock; //guards stopping and the result
+	int stopping;
+	//the latest result, until it is taken
+	int published, result, errorLine, errorColumn;
+	LevelPack pack;
+	Uint32 *hashes;
+	//the last levels parsed, records that did not change are copied from them
+	LevelPack previous;
+	Uint32 *previousHashes;
+	int inotify; //-1 if the file is polled
+} LevelWatch;
+
+int StartLevelWatch(LevelWatch *watch, const char *path);
+int TakeWatchedLevels(LevelWatch *watch, LevelPack *pack, Uint32 **hashes, int *errorLine, int *errorColumn);
+void StopLevelWatch(LevelWatch *watch);
+
+#endif
@@ -4,9 +4,23 @@
 #include <SDL_ttf.h>
 #include <SDL_image.h>
 #include <stdio.h>
-
-#define FOR_EACH(element, first) \
-	for ((element) = (first); (element); (element) = (element)->next)
+#include <string.h>
+#include <assert.h>
+#include "bitboard.h"
+#include "flowelement.h"
+#include "levelpack.h"
+#include "progress.h"
+#include "autosave.h"
+#include "levelwatch.h"
+#include "levelcatalog.h"
+#include "levelimport.h"
+#include "boardstore.h"
+#include "parallelsolver.h"
+#include "levelcnf.h"
+#include "hintengine.h"
+#include "uniquecheck.h"
+#include "benchmarks.h"
+#include "selftests.h"
 
 typedef enum GameState
 {
@@ -20,50 +34,48 @@ typedef enum GameState
 	Exit
 } GameState;
 
-typedef enum FlowElementShape
-{
-	None = 0,
-	UpS = (1<<0),
-	RightS = (1<<1),
-	DownS = (1<<2),
-	LeftS = (1<<3),
-	EndS = (1<<4)
-} FlowElementShape;
-
 typedef enum FlowDirection
 {
 	FromFirst = 1<<0,
 	FromLast = 1<<1
 }FlowDirection;
 
-typedef struct FlowElement
+typedef struct CellOwner
 {
-	struct FlowElement *prev, *next;
-	SDL_Rect position;
-	FlowElementShape shape;
-} FlowElement;
+	Uint16 element, flow;
+	int position;
+} CellOwner;
 
 typedef struct Flow
 {
-	FlowElement *firstElement;
-	FlowElement *lastElement;
+	Uint16 firstElement, lastElement;
+	Bitboard cells;
 	SDL_Color color;
 	int completed;
+	char shapesDirty; //the elements next to the endpoints need new shapes
 	FlowDirection direction;
 } Flow;
 
-typedef enum LevelState
-{
-	Uncompleted, Completed, Starred
-} LevelState;
-
-typedef struct Level
+typedef struct PlayState
 {
 	Flow *flows;
-	LevelState state;
-	unsigned int timeRecord;
+	CellOwner *cells;
+	Bitboard occupied, dirty; //dirty cells and their neighbours need new shapes
+	FlowElement *elements;
+	int freeElements, elementsUsed;
+	int completedFlowCount, innerFlowElementCount; //kept up to date by the routines changing the flows
 	int size, flowCount;
-} Level;
+	//the untouched level, restored on reset
+	const LevelPack *pack;
+	int levelIndex;
+	Flow *initialFlows;
+	CellOwner *initialCells;
+	FlowElement *initialElements;
+	Bitboard initialOccupied;
+	//the solve time: the ticks of the first move since the level was set up (0 before it)
+	//and the milliseconds spent on the board before that
+	Uint32 started, elapsed;
+} PlayState;
 
 typedef	struct MenuItem
 {
@@ -128,17 +140,23 @@ SDL_TimerID userTimer;
 SDL_Surface *screen, *icon, *starPic, *cMarkPic;
 TTF_Font *fontTitle, *fontNormal, *fontSmall;
 GameState gameState;
-Level *currentLevels, *defaultLevels, *userLevels;
-int currentLevelIndex, currentLevelCount, defaultLevelCount, userLevelCount,
-	currentLevelSelectPage, levelSelectPageCount, innerFlowElementCount,
-	completedFlowCount ,currentTimeTTime, currentTimeTScore,
+LevelPack *currentLevels, defaultLevels, userLevels;
+ProgressJournal progressJournal; //the progress of defaultLevels
+Autosave autosave;
+LevelWatch userLevelWatch; //reparses "userLevels.txt" whenever it changes
+Uint32 *userLevelHashes; //the record hashes of userLevels
+LevelCatalog catalog; //the packs of the level select, defaultLevels and the packs of the levels directory
+BoardStore boardStore; //the unfinished boards of the levels, stored whenever a move ends
+HintEngine hintEngine; //searches for a hint on the board of the current level whenever it changes
+PlayState playState;
+int currentLevelIndex, currentLevelSelectPage, levelSelectPageCount, currentTimeTTime, currentTimeTScore,
 	timeTHighScores[3], timeTScoreIndex;
 char exiting, screenBlurred, loadUserLevel, KeysDown[SDLK_LAST + 1] = {0},
-	*userLevelError = NULL, isTimeTrialGame;
-Uint32 currentTime;
+	*userLevelError = NULL, userLevelErrorText[80], isTimeTrialGame;
+Uint32 currentTime, solveTime; //solveTime is the time of the last solved level
 Uint32 aboutAnimation;
 MouseButtonState LMB;
-SDL_Rect mousePosition, mousePositionDown;
+SDL_Rect mousePosition, mousePositionDown, flowStartPosition;
 MenuItem mainMenuItems[] = {
 	"arcade", 0, 0, LevelSelectMenu, {250,34,49},
 	"time trial", 0, 0, TimeTrialMenu, {255,191,31},
@@ -155,7 +173,7 @@ TimeTrialMenuItem timeTrialMenuItems[] = {
 	"60 sec", 0, 0, 1, 60, {255,191,31},
 	"90 sec", 0, 0, 2, 90, {191,255,50}};
 LevelTile levelTiles[9] = {0};
-FlowElement *flowElementStart;
+int flowElementStart;
 Flow *flowStart;
 
 /// <summary>
@@ -430,220 +448,544 @@ void BlurW(SDL_Surface *surface, int amount)
 
 
 /// <summary>
-/// Removes the flow element at the postition and removes the broken off FlowElements in a level.
+/// Gets the owner record of a cell in a level.
 /// </summary>
-/// <param name="level">The level.</param>
-/// <param name="xIn">The x coordinate.</param>
-/// <param name="yIn">The y coordinate.</param>
-/// <param name="removeThis">Determines whether to remove the FlowElement at the positon,
-/// or remove only the rest.</param>
-/// <returns>Returns 1 if FlowElement can be removed or the position is free,
-/// 0 if the FlowElement at the position is the first or the last in a Flow.</returns>
-int RemoveFlowElement(Level *level, int xIn, int yIn, char removeThis)
+/// <param name="play">The play state.</param>
+/// <param name="x">The x coordinate.</param>
+/// <param name="y">The y coordinate.</param>
+/// <returns>Returns the owner record, or NULL if the position is outside the level.</returns>
+CellOwner *GetCellOwner(PlayState *play, int x, int y)
+{
+	if (play->cells == NULL || x < 0 || y < 0 || x >= play->size || y >= play->size)
+		return NULL;
+	return &play->cells[y * play->size + x];
+}
+
+/// <summary>
+/// Marks the cell of a FlowElement as owned by a flow.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="element">The index of the FlowElement.</param>
+/// <param name="flow">The index of the flow.</param>
+/// <param name="position">The position of the element along the flow,
+/// increasing from the first element towards the last.</param>
+void SetCellOwner(PlayState *play, int element, int flow, int position)
+{
+	int cell = play->elements[element].y * play->size + play->elements[element].x;
+	play->cells[cell].element = element;
+	play->cells[cell].flow = flow;
+	play->cells[cell].position = position;
+	BitboardSet(&play->occupied, cell);
+	BitboardSet(&play->flows[flow].cells, cell);
+	BitboardSet(&play->dirty, cell);
+	play->flows[flow].shapesDirty = 1;
+}
+
+/// <summary>
+/// Marks the cell of a FlowElement as free.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="element">The index of the FlowElement.</param>
+void ClearCellOwner(PlayState *play, int element)
+{
+	int cell = play->elements[element].y * play->size + play->elements[element].x;
+	BitboardClear(&play->occupied, cell);
+	BitboardClear(&play->flows[play->cells[cell].flow].cells, cell);
+	BitboardSet(&play->dirty, cell);
+	play->flows[play->cells[cell].flow].shapesDirty = 1;
+	play->cells[cell].element = NO_ELEMENT;
+}
+
+/// <summary>
+/// Marks the cell of a FlowElement for the next UpdateShapes.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="element">The index of the FlowElement.</param>
+void MarkShapeDirty(PlayState *play, int element)
+{
+	BitboardSet(&play->dirty, play->elements[element].y * play->size + play->elements[element].x);
+}
+
+/// <summary>
+/// Gets the position of a FlowElement along its flow.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="element">The index of the FlowElement.</param>
+/// <returns>Returns the position stored in the owner record of the element.</returns>
+int GetElementPosition(PlayState *play, int element)
+{
+	return play->cells[play->elements[element].y * play->size + play->elements[element].x].position;
+}
+
+/// <summary>
+/// Takes a FlowElement from the element pool of a level.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <returns>Returns the index of the FlowElement, or NO_ELEMENT if the pool is exhausted.</returns>
+int AllocFlowElement(PlayState *play)
 {
+	int element;
+	if (play->freeElements != NO_ELEMENT)
+	{
+		element = play->freeElements;
+		play->freeElements = play->elements[element].next;
+		play->innerFlowElementCount++;
+		return element;
+	}
+	if (play->elementsUsed >= play->size * play->size)
+		return NO_ELEMENT;
+	play->innerFlowElementCount++;
+	return play->elementsUsed++;
+}
+
+/// <summary>
+/// Gives a chain of FlowElements linked by next back to the element pool of a level.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="head">The index of the first FlowElement of the chain.</param>
+/// <param name="tail">The index of the last FlowElement of the chain.</param>
+/// <param name="count">The number of FlowElements in the chain.</param>
+void FreeFlowElements(PlayState *play, int head, int tail, int count)
+{
+	play->elements[tail].next = play->freeElements;
+	play->freeElements = head;
+	play->innerFlowElementCount -= count;
+}
+
+/// <summary>
+/// Completes or breaks a flow and keeps the completed flow count of the level up to date.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="flow">The flow.</param>
+/// <param name="completed">1 if the flow is completed, 0 otherwise.</param>
+void SetFlowCompleted(PlayState *play, Flow *flow, int completed)
+{
+	if (flow->completed == completed)
+		return;
+	flow->completed = completed;
+	play->completedFlowCount += completed ? 1 : -1;
+}
+
+#ifndef NDEBUG
+/// <summary>
+/// Recounts the completed flows and the routed FlowElements of a level
+/// and checks them against the incrementally kept counters.
+/// </summary>
+/// <param name="play">The play state.</param>
+void CheckLevelCounters(PlayState *play)
+{
+	int i, element, completed = 0, inner = 0;
 	Flow *f;
-	FlowElement *fElem1, *fElem2;
-	int a, b, i;
-	for (i = 0; i < level->flowCount; i++)
+	for (i = 0; i < play->flowCount; i++)
 	{
-		f = &level->flows[i];
-		FOR_EACH(fElem1, f->firstElement)
-		{
-			if (fElem1->position.x == xIn && fElem1->position.y == yIn)
-			{
-				if (f->completed)
-				{
-					if (fElem1 == f->firstElement || fElem1 == f->lastElement)
-					{
-						if (removeThis)
-							return 0;
-						else
-						{
-							RemoveFlowElement(level, f->firstElement->next->position.x, f->firstElement->next->position.y, 1);
-							RemoveFlowElement(level, f->lastElement->prev->position.x, f->lastElement->prev->position.y, 1);
-							f->direction = (FlowDirection)(FromFirst | FromLast);
-							f->completed = 0;
-							return 1;
-						}
-					}
-					//remove from xy until end (remove the shorter part)
-					for (fElem2 = fElem1->next, a = 0; fElem2 != f->lastElement; fElem2 = fElem2->next, a++);
-					for (fElem2 = fElem1->prev, b = 0; fElem2 != f->firstElement; fElem2 = fElem2->prev, b++);
-					if (a > b)
-					{
-						if (!removeThis) //skip one
-							fElem1 = fElem1->prev;
-						fElem1->next->prev = f->firstElement;
-						f->firstElement->next = fElem1->next;
-						f->direction = (FlowDirection)FromLast;
-						f->completed = 0;
-						RemoveFlowElement(level, f->lastElement->position.x, f->lastElement->position.y, 0);
-					}
-					else
-					{
-						if (!removeThis)
-							fElem1 = fElem1->next;
-						fElem1->prev->next = f->lastElement;
-						f->lastElement->prev = fElem1->prev;
-						f->direction = (FlowDirection)FromFirst;
-						f->completed = 0;
-						RemoveFlowElement(level, f->firstElement->position.x, f->firstElement->position.y, 1);
-					}
-					return 1;
-				}
-				else //not completed
-				{
-					if (removeThis)
-					{
-						if (fElem1 == f->firstElement || fElem1 == f->lastElement)
-							return 0;
-						if (f->direction & FromFirst)
-						{
-							fElem1->prev->next = f->lastElement;
-							f->lastElement->prev = fElem1->prev;
-						}
-						else
-						{
-							fElem1->next->prev = f->firstElement;
-							f->firstElement->next = fElem1->next;
-						}
-						do
-						{
-							fElem2 = (f->direction & FromFirst) ? fElem1->next : fElem1->prev;
-							free(fElem1);
-							fElem1 = fElem2;
-						}
-						while (!(fElem1 == f->lastElement || fElem1 == f->firstElement));
-						return 1;
-					}
-					else
-					{
-						if (f->direction & FromFirst)
-						{
-							if (fElem1->next != NULL)
-								return RemoveFlowElement(level, fElem1->next->position.x, fElem1->next->position.y, 1);
-							else
-								return 1;
-						}
-						else if (fElem1->prev != NULL)
-							return RemoveFlowElement(level, fElem1->prev->position.x, fElem1->prev->position.y, 1);
-						else
-							return 1;
-						return 0;
-					}
-				}
-			}
-		}
+		f = &play->flows[i];
+		if (f->completed)
+			completed++;
+		FOR_EACH(element, f->firstElement, play->elements)
+			if (element != f->firstElement && element != f->lastElement)
+				inner++;
 	}
-	return 1;
+	if (completed != play->completedFlowCount || inner != play->innerFlowElementCount ||
+		inner != BitboardCount(&play->occupied, BitboardWords(play->size)) - play->flowCount * 2)
+		fprintf(stderr, "level counters out of sync: completed %d/%d, inner %d/%d\n",
+			play->completedFlowCount, completed, play->innerFlowElementCount, inner);
+	assert(completed == play->completedFlowCount);
+	assert(inner == play->innerFlowElementCount);
+	assert(inner == BitboardCount(&play->occupied, BitboardWords(play->size)) - play->flowCount * 2);
+}
+#endif
+
+/// <summary>
+/// Removes every routed FlowElement of a level by restoring the template of the untouched level
+/// and resetting the element pool.
+/// </summary>
+/// <param name="play">The play state.</param>
+void ResetPlayState(PlayState *play)
+{
+	memcpy(play->flows, play->initialFlows, play->flowCount * sizeof(Flow));
+	memcpy(play->cells, play->initialCells, play->size * play->size * sizeof(CellOwner));
+	memcpy(play->elements, play->initialElements, play->flowCount * 2 * sizeof(FlowElement));
+	play->occupied = play->initialOccupied;
+	play->dirty = play->initialOccupied; //the endpoints need new shapes
+	play->elementsUsed = play->flowCount * 2; //the endpoints come first
+	play->freeElements = NO_ELEMENT;
+	play->completedFlowCount = 0;
+	play->innerFlowElementCount = 0;
+	play->started = 0;
+	play->elapsed = 0;
+}
+
+/// <summary>
+/// Gets the time spent solving a level.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <returns>Returns the time in milliseconds.</returns>
+Uint32 GetSolveTime(PlayState *play)
+{
+	return play->elapsed + (play->started != 0 ? SDL_GetTicks() - play->started : 0);
 }
 
 /// <summary>
-/// Frees the level.
+/// Sets up the play state for a level of a pack and keeps a template of it for ResetPlayState.
 /// </summary>
-/// <param name="level">The level.</param>
-void FreeLevelContent(Level *level)
+/// <param name="play">The play state.</param>
+/// <param name="pack">The level pack.</param>
+/// <param name="index">The index of the level in the pack.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int InitPlayState(PlayState *play, LevelPack *pack, int index)
 {
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	Flow *flows;
+	FlowElement *elements;
+	CellOwner *cells;
 	int i;
-	if (level == NULL)
-		return;
-	for (i = level->flowCount - 1; i >= 0; i--)
+	play->pack = NULL;
+	if ((def = GetPlayableLevel(pack, index, &endpoints)) == NULL)
+		return -1;
+	if ((flows = (Flow *)realloc(play->flows, def->flowCount * sizeof(Flow))) == NULL)
+		return -1;
+	play->flows = flows;
+	if ((flows = (Flow *)realloc(play->initialFlows, def->flowCount * sizeof(Flow))) == NULL)
+		return -1;
+	play->initialFlows = flows;
+	if ((elements = (FlowElement *)realloc(play->elements, def->size * def->size * sizeof(FlowElement))) == NULL)
+		return -1;
+	play->elements = elements;
+	if ((elements = (FlowElement *)realloc(play->initialElements, def->flowCount * 2 * sizeof(FlowElement))) == NULL)
+		return -1;
+	play->initialElements = elements;
+	if ((cells = (CellOwner *)realloc(play->cells, def->size * def->size * sizeof(CellOwner))) == NULL)
+		return -1;
+	play->cells = cells;
+	if ((cells = (CellOwner *)realloc(play->initialCells, def->size * def->size * sizeof(CellOwner))) == NULL)
+		return -1;
+	play->initialCells = cells;
+	play->size = def->size;
+	play->flowCount = def->flowCount;
+	memset(play->cells, 0xff, play->size * play->size * sizeof(CellOwner));
+	BitboardZero(&play->occupied, BitboardWords(play->size));
+	BitboardZero(&play->dirty, BitboardWords(play->size));
+	//the endpoints of flow i are the elements i * 2 and i * 2 + 1
+	for (i = 0; i < def->flowCount; i++)
 	{
-		RemoveFlowElement(level, level->flows[i].firstElement->next->position.x, level->flows[i].firstElement->next->position.y, 1);
-		RemoveFlowElement(level, level->flows[i].lastElement->prev->position.x, level->flows[i].lastElement->prev->position.y, 1);
-		free(level->flows[i].firstElement);
-		free(level->flows[i].lastElement);
-		level->flowCount--;
+		play->flows[i].firstElement = i * 2;
+		play->flows[i].lastElement = i * 2 + 1;
+		play->flows[i].color = FLOWCOLORS[i % (sizeof(FLOWCOLORS) / sizeof(SDL_Color))];
+		play->flows[i].completed = 0;
+		play->flows[i].direction = (FlowDirection)(FromFirst | FromLast);
+		BitboardZero(&play->flows[i].cells, BitboardWords(play->size));
+		play->elements[i * 2].x = endpoints[i * 4];
+		play->elements[i * 2].y = endpoints[i * 4 + 1];
+		play->elements[i * 2].prev = NO_ELEMENT;
+		play->elements[i * 2].next = i * 2 + 1;
+		play->elements[i * 2 + 1].x = endpoints[i * 4 + 2];
+		play->elements[i * 2 + 1].y = endpoints[i * 4 + 3];
+		play->elements[i * 2 + 1].prev = i * 2;
+		play->elements[i * 2 + 1].next = NO_ELEMENT;
+		SetCellOwner(play, i * 2, i, 0);
+		SetCellOwner(play, i * 2 + 1, i, 0);
 	}
-	free(level->flows);
+	memcpy(play->initialFlows, play->flows, play->flowCount * sizeof(Flow));
+	memcpy(play->initialCells, play->cells, play->size * play->size * sizeof(CellOwner));
+	memcpy(play->initialElements, play->elements, play->flowCount * 2 * sizeof(FlowElement));
+	play->initialOccupied = play->occupied;
+	play->pack = pack;
+	play->levelIndex = index;
+	ResetPlayState(play);
+	return 0;
 }
 
 /// <summary>
-/// Loads the levels from file.
+/// Frees the play state.
 /// </summary>
-/// <param name="file">The file.</param>
-/// <param name="levels">The levels.</param>
-/// <param name="count">The level count.</param>
-void LoadLevelsFromFile(FILE *file, Level **levels, int *count)
+/// <param name="play">The play state.</param>
+void FreePlayState(PlayState *play)
 {
-	char c;
-	int i, flowColorIndex, countRet;
-	Flow *flow, *flowsTemp;
-	Level *levelRet = NULL, *levelTemp;
-	*levels = NULL;
-	*count = 0;
-
-	countRet = 1;
-	levelRet = (Level *)malloc(sizeof(Level));
-	for(c = fgetc(file); c != EOF && c != '{'; c = fgetc(file));
-	if (c == EOF)
-		return;
-	if((levelRet[countRet - 1].flows = (Flow *)malloc(sizeof(Flow))) == NULL)
-		return;
-	levelRet[countRet - 1].flowCount = 1;
-	flowColorIndex = 0;
-	while (1)
+	free(play->flows);
+	free(play->cells);
+	free(play->elements);
+	free(play->initialFlows);
+	free(play->initialCells);
+	free(play->initialElements);
+	play->flows = play->initialFlows = NULL;
+	play->cells = play->initialCells = NULL;
+	play->elements = play->initialElements = NULL;
+	play->flowCount = 0;
+	play->pack = NULL;
+}
+
+/// <summary>
+/// Gets the direction of a FlowElement from the one before it.
+/// </summary>
+/// <param name="from">The FlowElement before.</param>
+/// <param name="to">The FlowElement next to it.</param>
+/// <returns>Returns 0 for up, 1 for right, 2 for down and 3 for left.</returns>
+int GetElementDirection(const FlowElement *from, const FlowElement *to)
+{
+	return to->y != from->y ? (to->y < from->y ? 0 : 2) : (to->x > from->x ? 1 : 3);
+}
+
+/// <summary>
+/// Encodes the routed paths of a level for the board store: the solve time so far as a varint,
+/// a varint per flow holding its step count shifted over whether it starts from the last endpoint,
+/// then the steps of every flow as 2 bit direction codes in the order of UpS, RightS, DownS and LeftS, 4 to a byte.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="board">The board, at least BOARDSTORE_MAX_LENGTH bytes.</param>
+/// <returns>Returns the length of the board, 0 if no flow is routed.</returns>
+int EncodePlayState(PlayState *play, Uint8 *board)
+{
+	Uint8 codes[BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE / 4], *position = board;
+	FlowElement *elements = play->elements;
+	Flow *f;
+	int i, e, next, to, fromLast, steps, total = 0;
+	memset(codes, 0, sizeof(codes));
+	WriteVarint(&position, GetSolveTime(play));
+	for (i = 0; i < play->flowCount; i++)
 	{
-		flow = &levelRet[countRet - 1].flows[levelRet[countRet - 1].flowCount - 1];
-		if((flow->firstElement = (FlowElement *)malloc(sizeof(FlowElement))) == NULL)
-			return;
-		if((flow->lastElement = (FlowElement *)malloc(sizeof(FlowElement))) == NULL)
-			return;
-		flow->firstElement->prev = NULL;
-		flow->firstElement->next = flow->lastElement;
-		flow->firstElement->shape = EndS;
-		flow->lastElement->next = NULL;
-		flow->lastElement->prev = flow->firstElement;
-		flow->lastElement->shape = EndS;
-		if(fscanf(file, "{%d,%d,%d,%d},",
-			&(flow->firstElement->position.x),
-			&(flow->firstElement->position.y),
-			&(flow->lastElement->position.x),
-			&(flow->lastElement->position.y)) < 4)
-			return;
-		flow->firstElement->position.x--;
-		flow->firstElement->position.y--;
-		flow->lastElement->position.x--;
-		flow->lastElement->position.y--;
-		flow->color = FLOWCOLORS[flowColorIndex++];
-		flow->completed = 0;
-		flow->direction = (FlowDirection)(FromFirst | FromLast);
-
-		if(fscanf(file, "%d,", &(levelRet[countRet - 1].size)) < 1) //there are more flows to read
+		//an unfinished flow is routed from one endpoint, a completed one is encoded from the first
+		f = &play->flows[i];
+		fromLast = !f->completed && !(f->direction & FromFirst);
+		e = fromLast ? f->lastElement : f->firstElement;
+		to = fromLast ? f->firstElement : f->lastElement;
+		for (steps = 0; e != to; e = next, steps++, total++)
 		{
-			if((flowsTemp = (Flow *)malloc(sizeof(Flow) * (levelRet[countRet - 1].flowCount + 1))) == NULL)
-				return;
-			for (i = 0; i < levelRet[countRet - 1].flowCount; i++)
-				flowsTemp[i] = levelRet[countRet - 1].flows[i];
-			free(levelRet[countRet - 1].flows);
-			levelRet[countRet - 1].flows = flowsTemp;
-			levelRet[countRet - 1].flowCount++;
+			next = fromLast ? elements[e].prev : elements[e].next;
+			if (next == to && !f->completed)
+				break;
+			codes[total / 4] |= GetElementDirection(&elements[e], &elements[next]) << total % 4 * 2;
 		}
-		else
+		WriteVarint(&position, steps << 1 | fromLast);
+	}
+	if (total == 0)
+		return 0;
+	memcpy(position, codes, (total + 3) / 4);
+	return position - board + (total + 3) / 4;
+}
+
+/// <summary>
+/// Routes the paths of a board encoded by EncodePlayState on the untouched level, in time linear
+/// in the length of the paths. A board that does not fit the level leaves the level untouched.
+/// </summary>
+/// <param name="play">The play state of the untouched level.</param>
+/// <param name="board">The board.</param>
+/// <param name="length">The length of the board.</param>
+/// <returns>Returns -1 if the board does not fit the level, 0 otherwise.</returns>
+int RestorePlayState(PlayState *play, const Uint8 *board, int length)
+{
+	const int stepX[4] = {0, 1, 0, -1}, stepY[4] = {-1, 0, 1, 0};
+	const Uint8 *position = board, *codes, *end = board + length;
+	FlowElement *elements = play->elements;
+	Flow *f;
+	Uint32 header, elapsed;
+	int i, k, x, y, fe1, fe2, to, fromLast, code, total = 0;
+	//the codes follow the solve time and the headers of every flow
+	if (ReadVarint(&position, end, &elapsed) == -1)
+		return -1;
+	for (i = 0; i < play->flowCount; i++)
+	{
+		if (ReadVarint(&position, end, &header) == -1 || header >> 1 > (Uint32)(play->size * play->size))
+			return -1;
+		total += header >> 1;
+	}
+	if (end - position != (total + 3) / 4)
+		return -1;
+	codes = position;
+	position = board;
+	ReadVarint(&position, end, &elapsed);
+	total = 0;
+	for (i = 0; i < play->flowCount; i++)
+	{
+		ReadVarint(&position, end, &header);
+		f = &play->flows[i];
+		fromLast = header & 1;
+		fe1 = fromLast ? f->lastElement : f->firstElement;
+		to = fromLast ? f->firstElement : f->lastElement;
+		x = elements[fe1].x;
+		y = elements[fe1].y;
+		for (k = 0; k < (int)(header >> 1); k++, total++)
 		{
-			if(fscanf(file, "%d,%d}",
-				&(levelRet[countRet - 1].state),
-				&(levelRet[countRet - 1].timeRecord)) < 2)
-				return;
-			for(c = fgetc(file); c != EOF && c != '{'; c = fgetc(file));
-			if (c == EOF)
+			code = codes[total / 4] >> total % 4 * 2 & 3;
+			x += stepX[code];
+			y += stepY[code];
+			if (x < 0 || y < 0 || x >= play->size || y >= play->size)
+				break;
+			//only the last step of a flow from the first endpoint may complete it
+			if (elements[to].x == x && elements[to].y == y)
+			{
+				if (fromLast || k != (int)(header >> 1) - 1)
+					break;
+				elements[fe1].next = to;
+				elements[to].prev = fe1;
+				SetFlowCompleted(play, f, 1);
+				continue;
+			}
+			if (BitboardTest(&play->occupied, y * play->size + x) || (fe2 = AllocFlowElement(play)) == NO_ELEMENT)
+				break;
+			if (fromLast)
 			{
-				*count = countRet;
-				*levels = levelRet;
-				return;
+				elements[fe1].prev = fe2;
+				elements[to].next = fe2;
+				elements[fe2].prev = to;
+				elements[fe2].next = fe1;
 			}
-			levelTemp = (Level *)malloc(sizeof(Level) * (countRet + 1));
-			for (i = 0; i < countRet; i++)
-				levelTemp[i] = levelRet[i];
-			free(levelRet);
-			levelRet = levelTemp;
-			countRet++;
-			if((levelRet[countRet - 1].flows = (Flow *)malloc(sizeof(Flow))) == NULL)
-				return;
-			levelRet[countRet - 1].flowCount = 1;
-			flowColorIndex = 0;
+			else
+			{
+				elements[fe1].next = fe2;
+				elements[to].prev = fe2;
+				elements[fe2].prev = fe1;
+				elements[fe2].next = to;
+			}
+			elements[fe2].x = x;
+			elements[fe2].y = y;
+			SetCellOwner(play, fe2, i, GetElementPosition(play, fe1) + (fromLast ? -1 : 1));
+			fe1 = fe2;
 		}
+		if (k < (int)(header >> 1))
+		{
+			ResetPlayState(play);
+			return -1;
+		}
+		if (header >> 1 > 0 && !f->completed)
+			f->direction = (FlowDirection)(fromLast ? FromLast : FromFirst);
 	}
+	play->elapsed = elapsed; //the clock goes on at the next move
+	return 0;
+}
+
+/// <summary>
+/// Posts the routed paths of a level to the hint engine, which starts over on them.
+/// Time trials have no hints.
+/// </summary>
+/// <param name="play">The play state.</param>
+void PostPlayHint(PlayState *play)
+{
+	HintRequest request;
+	FlowElement *elements = play->elements;
+	Flow *f;
+	int i, e, next, to, fromLast, count = 0;
+	if (isTimeTrialGame || play->pack == NULL || play->flowCount > SOLVER_MAX_FLOWS)
+		return;
+	request.size = play->size;
+	request.flowCount = play->flowCount;
+	for (i = 0; i < play->flowCount; i++)
+	{
+		f = &play->flows[i];
+		request.endpoints[i * 4] = elements[f->firstElement].x;
+		request.endpoints[i * 4 + 1] = elements[f->firstElement].y;
+		request.endpoints[i * 4 + 2] = elements[f->lastElement].x;
+		request.endpoints[i * 4 + 3] = elements[f->lastElement].y;
+		//the paths are walked as EncodePlayState walks them, a completed flow from its first endpoint
+		fromLast = !f->completed && !(f->direction & FromFirst);
+		e = fromLast ? f->lastElement : f->firstElement;
+		to = fromLast ? f->firstElement : f->lastElement;
+		request.moveStarts[i * 2] = (Uint16)count;
+		if (fromLast)
+			request.moveStarts[i * 2 + 1] = (Uint16)count;
+		for (; e != to; e = next)
+		{
+			next = fromLast ? elements[e].prev : elements[e].next;
+			if (next == to && !f->completed)
+				break;
+			request.moves[count++] = (Uint8)GetElementDirection(&elements[e], &elements[next]);
+		}
+		if (!fromLast)
+			request.moveStarts[i * 2 + 1] = (Uint16)count;
+	}
+	request.moveStarts[play->flowCount * 2] = (Uint16)count;
+	PostHintRequest(&hintEngine, &request);
+}
+
+/// <summary>
+/// Cuts the routed FlowElements of a flow from an element towards one of the endpoints
+/// and gives them back to the element pool in one piece.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="f">The flow.</param>
+/// <param name="element">The first FlowElement to remove, must not be an endpoint.</param>
+/// <param name="side">FromFirst removes towards the last element, FromLast towards the first.</param>
+/// <returns>Returns the number of removed FlowElements.</returns>
+int TruncateFlow(PlayState *play, Flow *f, int element, FlowDirection side)
+{
+	FlowElement *elements = play->elements;
+	int head, tail, e, count;
+	if (side & FromFirst)
+	{
+		head = element;
+		tail = elements[f->lastElement].prev;
+		elements[elements[head].prev].next = f->lastElement;
+		elements[f->lastElement].prev = elements[head].prev;
+	}
+	else
+	{
+		head = elements[f->firstElement].next;
+		tail = element;
+		elements[elements[tail].next].prev = f->firstElement;
+		elements[f->firstElement].next = elements[tail].next;
+	}
+	count = 1;
+	for (e = head; e != tail; e = elements[e].next, count++)
+		ClearCellOwner(play, e);
+	ClearCellOwner(play, tail);
+	FreeFlowElements(play, head, tail, count);
+	return count;
+}
+
+/// <summary>
+/// Removes the flow element at the postition and removes the broken off FlowElements in a level.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="xIn">The x coordinate.</param>
+/// <param name="yIn">The y coordinate.</param>
+/// <param name="removeThis">Determines whether to remove the FlowElement at the positon,
+/// or remove only the rest.</param>
+/// <returns>Returns the number of removed FlowElements (0 if the position is free),
+/// or -1 if the FlowElement at the position is the first or the last in a Flow and removeThis is set.</returns>
+int RemoveFlowElement(PlayState *play, int xIn, int yIn, char removeThis)
+{
+	Flow *f;
+	FlowElement *elements = play->elements;
+	CellOwner *owner;
+	int fElem1, a, b;
+	if ((owner = GetCellOwner(play, xIn, yIn)) == NULL || owner->element == NO_ELEMENT)
+		return 0;
+	f = &play->flows[owner->flow];
+	f->shapesDirty = 1;
+	fElem1 = owner->element;
+	if (fElem1 == f->firstElement || fElem1 == f->lastElement)
+	{
+		if (removeThis)
+			return -1;
+		if (f->completed)
+		{
+			//break the flow at an endpoint, every routed element goes
+			SetFlowCompleted(play, f, 0);
+			f->direction = (FlowDirection)(FromFirst | FromLast);
+			fElem1 = elements[f->firstElement].next;
+			return fElem1 == f->lastElement ? 0 : TruncateFlow(play, f, fElem1, FromFirst);
+		}
+		//remove everything after the endpoint
+		fElem1 = (f->direction & FromFirst) ? elements[fElem1].next : elements[fElem1].prev;
+		if (fElem1 == NO_ELEMENT || fElem1 == f->firstElement || fElem1 == f->lastElement)
+			return 0;
+		return TruncateFlow(play, f, fElem1, (f->direction & FromFirst) ? FromFirst : FromLast);
+	}
+	if (f->completed)
+	{
+		//remove from xy until end (remove the shorter part)
+		a = GetElementPosition(play, elements[f->lastElement].prev) - owner->position;
+		b = owner->position - GetElementPosition(play, elements[f->firstElement].next);
+		SetFlowCompleted(play, f, 0);
+		f->direction = (FlowDirection)(a > b ? FromLast : FromFirst);
+	}
+	if (!removeThis) //skip one
+	{
+		fElem1 = (f->direction & FromFirst) ? elements[fElem1].next : elements[fElem1].prev;
+		if (fElem1 == f->firstElement || fElem1 == f->lastElement)
+			return 0;
+	}
+	return TruncateFlow(play, f, fElem1, (f->direction & FromFirst) ? FromFirst : FromLast);
 }
 
 /// <summary>
@@ -654,35 +996,35 @@ void LoadLevelsFromFile(FILE *file, Level **levels, int *count)
 /// <returns>Returns -1 on error, 0 otherwise.</returns>
 int MakeRoute(int x, int y)
 {
-	int i, j, k, l;
-	FlowElement *fe1;
-	if (flowElementStart == NULL || flowStart == NULL)
+	int i, j, k, l, flowIndex, fe1, fe2, cell;
+	FlowElement *elements;
+	CellOwner *owner;
+	PlayState *play;
+	if (flowElementStart == NO_ELEMENT || flowStart == NULL)
 		return -1;
+	play = &playState;
+	elements = play->elements;
+	flowIndex = flowStart - play->flows;
+	flowStart->shapesDirty = 1;
+	owner = GetCellOwner(play, x, y);
 	if (flowStart->completed)
 	{
-		if (flowElementStart->position.x == x && flowElementStart->position.y == y)
-			RemoveFlowElement(&currentLevels[currentLevelIndex], flowElementStart->position.x, flowElementStart->position.y, 0);
-		else //completed flow, but not released mouse yet
+		if (flowStartPosition.x == x && flowStartPosition.y == y)
+			RemoveFlowElement(play, x, y, 0);
+		else if (owner != NULL && owner->element != NO_ELEMENT && owner->flow == flowIndex) //completed flow, but not released mouse yet
 		{
-			//find flowelement if it is under xy
-			FOR_EACH(fe1, flowStart->firstElement)
+			fe1 = owner->element;
+			if (fe1 == elements[flowStart->firstElement].next &&
+				(fe1 != flowStart->lastElement || flowElementStart == flowStart->lastElement))
 			{
-				if (fe1->position.x == x && fe1->position.y == y)
-				{
-					if (fe1 == flowStart->firstElement->next &&
-						(fe1 != flowStart->lastElement || flowElementStart == flowStart->lastElement))
-					{
-						flowStart->direction = (FlowDirection)FromLast;
-						flowStart->completed = 0;
-					}
-					else if(fe1 == flowStart->lastElement->prev &&
-						(fe1 != flowStart->firstElement || flowElementStart == flowStart->firstElement))
-					{
-						flowStart->direction = (FlowDirection)FromFirst;
-						flowStart->completed = 0;
-					}
-					break;
-				}
+				flowStart->direction = (FlowDirection)FromLast;
+				SetFlowCompleted(play, flowStart, 0);
+			}
+			else if(fe1 == elements[flowStart->lastElement].prev &&
+				(fe1 != flowStart->firstElement || flowElementStart == flowStart->firstElement))
+			{
+				flowStart->direction = (FlowDirection)FromFirst;
+				SetFlowCompleted(play, flowStart, 0);
 			}
 		}
 	}
@@ -696,45 +1038,47 @@ int MakeRoute(int x, int y)
 		if (flowStart->direction & FromFirst)
 		{
 			//remove flowElements after xy
-			FOR_EACH(fe1, flowStart->firstElement)
-			{
-				if (fe1->position.x == x && fe1->position.y == y) //xy is in flowStart
-					RemoveFlowElement(&currentLevels[currentLevelIndex], fe1->position.x, fe1->position.y, 0);
-			}
+			if (owner != NULL && owner->element != NO_ELEMENT && owner->flow == flowIndex) //xy is in flowStart
+				RemoveFlowElement(play, x, y, 0);
 			//add new FLowElements (xy is not in FLowStart)
-			fe1 = flowStart->lastElement->prev;
-			k = y - fe1->position.y;
-			l = x - fe1->position.x;
+			fe1 = elements[flowStart->lastElement].prev;
+			k = y - elements[fe1].y;
+			l = x - elements[fe1].x;
 			//advenced route not yet implemented, only left and right connection
 			if (!(((k == 0) && (l != 0)) || ((l == 0) && (k != 0))))
 				return 0;
-			i = fe1->position.y + (k == 0 ? 0 : (k > 0 ? 1 : -1));
+			i = elements[fe1].y + (k == 0 ? 0 : (k > 0 ? 1 : -1));
 			do
 			{
-				j = fe1->position.x + (l == 0 ? 0 : (l > 0 ? 1 : -1));
+				j = elements[fe1].x + (l == 0 ? 0 : (l > 0 ? 1 : -1));
 				do
 				{
 					//flow completed
-					if (flowStart->lastElement->position.x == j && flowStart->lastElement->position.y == i)
+					if (elements[flowStart->lastElement].x == j && elements[flowStart->lastElement].y == i)
 					{
-						fe1->next = flowStart->lastElement;
-						flowStart->lastElement->prev = fe1;
-						flowStart->completed = 1;
+						elements[fe1].next = flowStart->lastElement;
+						elements[flowStart->lastElement].prev = fe1;
+						SetFlowCompleted(play, flowStart, 1);
 						flowStart->direction = (FlowDirection)(FromFirst | FromLast);
 						return 0;
 					}
-					if(RemoveFlowElement(&currentLevels[currentLevelIndex], j, i, 1))
+					cell = i * play->size + j;
+					if (BitboardTest(&flowStart->cells, cell)) //crossing itself
+						return 0;
+					if(!BitboardTest(&play->occupied, cell) || RemoveFlowElement(play, j, i, 1) >= 0)
 					{
-						if((fe1->next = (FlowElement *)malloc(sizeof(FlowElement))) == NULL)
+						if((fe2 = AllocFlowElement(play)) == NO_ELEMENT)
 							return -1;
-						flowStart->lastElement->prev = fe1->next;
-						fe1->next->next = flowStart->lastElement;
-						fe1->next->prev = fe1;
-						fe1->next->position.x = j;
-						fe1->next->position.y = i;
-						fe1 = flowStart->lastElement->prev;
-						k = y - fe1->position.y;
-						l = x - fe1->position.x;
+						elements[fe1].next = fe2;
+						elements[flowStart->lastElement].prev = fe2;
+						elements[fe2].next = flowStart->lastElement;
+						elements[fe2].prev = fe1;
+						elements[fe2].x = j;
+						elements[fe2].y = i;
+						SetCellOwner(play, fe2, flowIndex, GetElementPosition(play, fe1) + 1);
+						fe1 = fe2;
+						k = y - elements[fe1].y;
+						l = x - elements[fe1].x;
 						if (!(((k == 0) && (l != 0)) || ((l == 0) && (k != 0))))
 							return 0;
 					}
@@ -749,45 +1093,46 @@ int MakeRoute(int x, int y)
 		else
 		{
 			//remove flowElements after xy
-			FOR_EACH(fe1, flowStart->firstElement)
-			{
-				if (fe1->position.x == x && fe1->position.y == y)//xy is in FlowStart
-					RemoveFlowElement(&currentLevels[currentLevelIndex], fe1->position.x, fe1->position.y, 0);
-			}
+			if (owner != NULL && owner->element != NO_ELEMENT && owner->flow == flowIndex) //xy is in FlowStart
+				RemoveFlowElement(play, x, y, 0);
 			//add new FLowElements (xy is not in FLowStart)
-			fe1 = flowStart->firstElement->next;
-			l = x - fe1->position.x;
-			k = y - fe1->position.y;
+			fe1 = elements[flowStart->firstElement].next;
+			l = x - elements[fe1].x;
+			k = y - elements[fe1].y;
 			if (!(((k == 0) && (l != 0)) || ((l == 0) && (k != 0))))
 				return 0;
-			i = fe1->position.y + (k == 0 ? 0 : (k > 0 ? 1 : -1));
+			i = elements[fe1].y + (k == 0 ? 0 : (k > 0 ? 1 : -1));
 			do
 			{
-				j = fe1->position.x + (l == 0 ? 0 : (l > 0 ? 1 : -1));
+				j = elements[fe1].x + (l == 0 ? 0 : (l > 0 ? 1 : -1));
 				do
 				{
 					//flow completed
-					if (flowStart->firstElement->position.x == j && flowStart->firstElement->position.y == i)
+					if (elements[flowStart->firstElement].x == j && elements[flowStart->firstElement].y == i)
 					{
-						fe1->prev = flowStart->firstElement;
-						flowStart->firstElement->next = fe1;
-						flowStart->completed = 1;
+						elements[fe1].prev = flowStart->firstElement;
+						elements[flowStart->firstElement].next = fe1;
+						SetFlowCompleted(play, flowStart, 1);
 						flowStart->direction = (FlowDirection)(FromFirst | FromLast);
 						return 0;
 					}
-					if(RemoveFlowElement(&currentLevels[currentLevelIndex], j, i, 1))
+					cell = i * play->size + j;
+					if (BitboardTest(&flowStart->cells, cell)) //crossing itself
+						return 0;
+					if(!BitboardTest(&play->occupied, cell) || RemoveFlowElement(play, j, i, 1) >= 0)
 					{
-						fe1->prev = (FlowElement *)malloc(sizeof(FlowElement));
-						if (fe1->prev == NULL)
+						if((fe2 = AllocFlowElement(play)) == NO_ELEMENT)
 							return -1;
-						flowStart->firstElement->next = fe1->prev;
-						fe1->prev->prev = flowStart->firstElement;
-						fe1->prev->next = fe1;
-						fe1->prev->position.x = j;
-						fe1->prev->position.y = i;
-						fe1 = flowStart->firstElement->next;
-						l = x - fe1->position.x;
-						k = y - fe1->position.y;
+						elements[fe1].prev = fe2;
+						elements[flowStart->firstElement].next = fe2;
+						elements[fe2].prev = flowStart->firstElement;
+						elements[fe2].next = fe1;
+						elements[fe2].x = j;
+						elements[fe2].y = i;
+						SetCellOwner(play, fe2, flowIndex, GetElementPosition(play, fe1) - 1);
+						fe1 = fe2;
+						l = x - elements[fe1].x;
+						k = y - elements[fe1].y;
 						if (!(((k == 0) && (l != 0)) || ((l == 0) && (k != 0))))
 							return 0;
 					}
@@ -841,64 +1186,113 @@ int InRect(int x, int y, int w, int h, SDL_Rect point)
 /// <param name="to">The FlowElement to add connection.</param>
 void ShapeAddConnection(FlowElement *from, FlowElement *to)
 {
-	if (from->position.x > to->position.x)
+	if (from->x > to->x)
 	{
-		to->shape = (FlowElementShape)(to->shape | RightS);
+		to->shape |= RightS;
 	}
-	else if(from->position.x < to->position.x)
+	else if(from->x < to->x)
 	{
-		to->shape = (FlowElementShape)(to->shape | LeftS);
+		to->shape |= LeftS;
 	}
-	else if (from->position.y > to->position.y)
+	else if (from->y > to->y)
+	{
+		to->shape |= DownS;
+	}
+	else
 	{
-		to->shape = (FlowElementShape)(to->shape | DownS);
+		to->shape |= UpS;
+	}
+}
+
+/// <summary>
+/// Updates the shape of a FlowElement from its connections.
+/// </summary>
+/// <param name="play">The play state.</param>
+/// <param name="f">The flow of the FlowElement.</param>
+/// <param name="a">The index of the FlowElement.</param>
+void UpdateElementShape(PlayState *play, Flow *f, int a)
+{
+	FlowElement *elements, *feA;
+	elements = play->elements;
+	feA = &elements[a];
+	feA->shape = (a == f->firstElement || a == f->lastElement) ? EndS : None;
+	if (f->completed)
+	{
+		if (feA->next != NO_ELEMENT)
+		{
+			ShapeAddConnection(&elements[feA->next], feA);
+		}
+		if (feA->prev != NO_ELEMENT)
+		{
+			ShapeAddConnection(&elements[feA->prev], feA);
+		}
 	}
 	else
 	{
-		to->shape = (FlowElementShape)(to->shape | UpS);
+		if (feA->next != NO_ELEMENT &&
+			((feA->next != f->lastElement) || (f->direction & FromLast) && (a != f->firstElement)) &&
+			((a != f->firstElement) || (f->direction & FromFirst) && (feA->next != f->lastElement)))
+		{
+			ShapeAddConnection(&elements[feA->next], feA);
+		}
+		if (feA->prev != NO_ELEMENT &&
+			((feA->prev != f->firstElement) || (f->direction & FromFirst) && (a != f->lastElement)) &&
+			((a != f->lastElement) || (f->direction & FromLast) && (feA->prev != f->firstElement)))
+		{
+			ShapeAddConnection(&elements[feA->prev], feA);
+		}
 	}
 }
 
 /// <summary>
-/// Updates the FlowElement shapes
+/// Updates the FlowElement shapes in the dirty cells and their neighbours
 /// </summary>
 void UpdateShapes()
 {
-	Level *level;
-	FlowElement *feA;
-	int i;
-	level = &currentLevels[currentLevelIndex];
-	for (i = 0; i < level->flowCount; i++)
+	PlayState *play;
+	Flow *f;
+	Bitboard update;
+	Uint64 word;
+	int i, cell, words;
+	play = &playState;
+	words = BitboardWords(play->size);
+	//the shapes next to the endpoints depend on the direction and completion of the flow
+	for (i = 0; i < play->flowCount; i++)
 	{
-		FOR_EACH(feA, level->flows[i].firstElement)
+		f = &play->flows[i];
+		if (f->shapesDirty)
 		{
-			feA->shape = (feA == level->flows[i].firstElement || feA == level->flows[i].lastElement) ? EndS : None;
-			if (level->flows[i].completed)
-			{
-				if (feA->next != NULL)
-				{
-					ShapeAddConnection(feA->next, feA);
-				}
-				if (feA->prev != NULL)
-				{
-					ShapeAddConnection(feA->prev, feA);
-				}
-			}
-			else
-			{
-				if (feA->next != NULL &&
-					((feA->next != level->flows[i].lastElement) || (level->flows[i].direction & FromLast) && (feA != level->flows[i].firstElement)) &&
-					((feA != level->flows[i].firstElement) || (level->flows[i].direction & FromFirst) && (feA->next != level->flows[i].lastElement)))
-				{
-					ShapeAddConnection(feA->next, feA);
-				}
-				if (feA->prev != NULL &&
-					((feA->prev != level->flows[i].firstElement) || (level->flows[i].direction & FromFirst) && (feA != level->flows[i].lastElement)) &&
-					((feA != level->flows[i].lastElement) || (level->flows[i].direction & FromLast) && (feA->prev != level->flows[i].firstElement)))
-				{
-					ShapeAddConnection(feA->prev, feA);
-				}
-			}
+			MarkShapeDirty(play, f->firstElement);
+			MarkShapeDirty(play, play->elements[f->firstElement].next);
+			MarkShapeDirty(play, f->lastElement);
+			MarkShapeDirty(play, play->elements[f->lastElement].prev);
+			f->shapesDirty = 0;
+		}
+	}
+	BitboardZero(&update, words);
+	for (i = 0; i < words; i++)
+	{
+		for (word = play->dirty.words[i]; word != 0; word &= word - 1)
+		{
+			cell = i * 64 + LowestBit64(word);
+			BitboardSet(&update, cell);
+			if (cell % play->size > 0)
+				BitboardSet(&update, cell - 1);
+			if (cell % play->size < play->size - 1)
+				BitboardSet(&update, cell + 1);
+			if (cell >= play->size)
+				BitboardSet(&update, cell - play->size);
+			if (cell < play->size * (play->size - 1))
+				BitboardSet(&update, cell + play->size);
+		}
+	}
+	BitboardZero(&play->dirty, words);
+	for (i = 0; i < words; i++)
+	{
+		for (word = update.words[i] & play->occupied.words[i]; word != 0; word &= word - 1)
+		{
+			cell = i * 64 + LowestBit64(word);
+			UpdateElementShape(play, &play->flows[play->cells[cell].flow], play->cells[cell].element);
 		}
 	}
 }
@@ -909,28 +1303,33 @@ void UpdateShapes()
 /// <param name="levelIndex">Index of the currentLevels.</param>
 void SetCurrentLevel(int levelIndex)
 {
-	int i;
-	if (currentLevelCount > 1)
+	const Uint8 *board;
+	int length;
+	if (currentLevels->count > 0)
 	{
-		if (levelIndex > currentLevelCount - 1)
-			levelIndex = currentLevelCount - 1;
+		if (levelIndex > currentLevels->count - 1)
+			levelIndex = currentLevels->count - 1;
 		else if (levelIndex < 0)
 			levelIndex = 0;
 	}
 	else
 		return;
 	currentLevelIndex = levelIndex;
-	innerFlowElementCount = 0;
-	completedFlowCount = 0;
-	//reset currentLevels
-	for (i = 0; i < currentLevels[levelIndex].flowCount; i++)
+	//only the current level has a play state, reloading it restores its template
+	if (playState.pack == currentLevels && playState.levelIndex == levelIndex)
+		ResetPlayState(&playState);
+	else if (InitPlayState(&playState, currentLevels, levelIndex) == -1)
 	{
-		RemoveFlowElement(&currentLevels[levelIndex], currentLevels[levelIndex].flows[i].firstElement->position.x,
-			currentLevels[levelIndex].flows[i].firstElement->position.y, 0);
-		RemoveFlowElement(&currentLevels[levelIndex], currentLevels[levelIndex].flows[i].lastElement->position.x,
-			currentLevels[levelIndex].flows[i].lastElement->position.y, 0);
+		printf("Unable to set up level %d\n", levelIndex + 1);
+		exiting = 1;
+		return;
 	}
+	//a level left unfinished comes back as it was, time trials start untouched
+	if (!isTimeTrialGame && (board = GetStoredBoard(&boardStore, currentLevels, levelIndex, &length)) != NULL &&
+		RestorePlayState(&playState, board, length) == -1)
+		RemoveStoredBoard(&boardStore, currentLevels, levelIndex);
 	UpdateShapes();
+	PostPlayHint(&playState);
 }
 
 /// <summary>
@@ -972,6 +1371,68 @@ void ProcessEvents()
 	}
 }
 
+/// <summary>
+/// Takes the user levels reparsed by userLevelWatch. Unchanged levels keep their progress
+/// and the board of the current level is kept if the level did not change.
+/// </summary>
+void UpdateUserLevels()
+{
+	LevelPack pack;
+	Uint32 *hashes;
+	int i, j, line, column, result, activeLevel = -1, *moved;
+	if ((result = TakeWatchedLevels(&userLevelWatch, &pack, &hashes, &line, &column)) == 0)
+		return;
+	if (result == -1)
+	{
+		//the levels loaded before stay playable
+		if (line == 0)
+			userLevelError = "\"userLevels.txt\" could not be loaded.";
+		else
+		{
+			sprintf(userLevelErrorText, "\"userLevels.txt\" has wrong format at %d:%d.", line, column);
+			userLevelError = userLevelErrorText;
+		}
+		return;
+	}
+	userLevelError = NULL;
+	//the stored boards follow their levels, NULL drops them; the extra element keeps malloc from
+	//returning NULL for an empty pack
+	if ((moved = (int *)malloc((userLevels.count + 1) * sizeof(int))) != NULL)
+		for (i = 0; i < userLevels.count; i++)
+			moved[i] = -1;
+	for (i = 0; i < pack.count; i++)
+	{
+		//a hash hit is only the same level if the contents match
+		if ((j = FindLevelHash(userLevelHashes, userLevels.count, hashes[i], i)) == -1 ||
+			!IsSameLevel(&pack, i, &userLevels, j))
+			continue;
+		if (moved != NULL)
+			moved[j] = i;
+		pack.levels[i].state = GetLevelDef(&userLevels, j)->state;
+		pack.levels[i].timeRecord = GetLevelDef(&userLevels, j)->timeRecord;
+		if (activeLevel == -1 && playState.pack == &userLevels && playState.levelIndex == j)
+			activeLevel = i;
+	}
+	MoveStoredBoards(&boardStore, &userLevels, moved, userLevels.count);
+	free(moved);
+	FreeLevelPack(&userLevels);
+	free(userLevelHashes);
+	userLevels = pack;
+	userLevelHashes = hashes;
+	if (activeLevel != -1)
+	{
+		playState.levelIndex = activeLevel; //the board only depends on the level
+		if (currentLevels == &userLevels)
+			currentLevelIndex = activeLevel;
+	}
+	else if (playState.pack == &userLevels)
+	{
+		playState.pack = NULL; //the level changed or is gone
+		if (currentLevels == &userLevels)
+			SetCurrentLevel(currentLevelIndex);
+	}
+}
+
 void Draw();
 
 /// <summary>
@@ -980,9 +1441,14 @@ void Draw();
 /// <returns>Returns -1 on error, 0 otherwise.</returns>
 int Update()
 {
-	int i, j, textW, textH, margin;
+	int i, j, textW, textH, margin, level;
 	SDL_Rect v;
-	FlowElement *fElem1;
+	CellOwner *owner;
+	LevelDef *def;
+	LevelState state;
+	Uint32 timeRecord;
+	Uint8 board[BOARDSTORE_MAX_LENGTH];
+	UpdateUserLevels();
 	switch (gameState)
 	{
 	case MainMenu:
@@ -1014,8 +1480,7 @@ int Update()
 		break;
 
 	case LevelSelectMenu:
-		currentLevels = defaultLevels;
-		currentLevelCount = defaultLevelCount;
+		currentLevels = &defaultLevels;
 		arrowBack.gameState = MainMenu;
 		arrowNext.position.y = LEVEL_TILE_MARGIN_TOP + 3 * LEVEL_TILE_SIZE + 2 * LEVEL_TILE_PADDING + 20;
 		arrowPrev.position.y = arrowNext.position.y;
@@ -1043,7 +1508,8 @@ int Update()
 					{
 						if(LMB == JustUp && levelTiles[i * 3 + j].mouseDown)
 						{
-							SetCurrentLevel(i * 3 + j + currentLevelSelectPage * 9);
+							currentLevels = FindCatalogLevel(&catalog, i * 3 + j + currentLevelSelectPage * 9, &level);
+							SetCurrentLevel(level);
 							gameState = ActiveGame;
 							Update();
 							arrowBack.gameState = LevelSelectMenu;
@@ -1067,95 +1533,111 @@ int Update()
 		if (IsButtonClicked(&arrowBack))
 			gameState = arrowBack.gameState;
 		if (IsButtonClicked(&reload))
+		{
+			if (!isTimeTrialGame)
+				RemoveStoredBoard(&boardStore, currentLevels, currentLevelIndex);
 			SetCurrentLevel(currentLevelIndex);
+		}
 		if (!isTimeTrialGame)
 		{
 			//next currentLevels button
-			if (currentLevelIndex != currentLevelCount - 1 && IsButtonClicked(&arrowNext))
+			if (currentLevelIndex != currentLevels->count - 1 && IsButtonClicked(&arrowNext))
 			{
 				SetCurrentLevel(currentLevelIndex + 1);
-				if (currentLevels == defaultLevels)
-					currentLevelSelectPage = (currentLevelIndex) / 9;
+				if ((i = GetCatalogIndex(&catalog, currentLevels, currentLevelIndex)) != -1)
+					currentLevelSelectPage = i / 9;
 			}
 			else if (currentLevelIndex > 0 && IsButtonClicked(&arrowPrev))
 			{
 				SetCurrentLevel(currentLevelIndex - 1);
-				if (currentLevels == defaultLevels)
-					currentLevelSelectPage = (currentLevelIndex) / 9;
+				if ((i = GetCatalogIndex(&catalog, currentLevels, currentLevelIndex)) != -1)
+					currentLevelSelectPage = i / 9;
 			}
 		}
-		else if (SDL_GetTicks() - 1000 > currentTime)
+		else
 		{
-			currentTime = SDL_GetTicks();
-			if (--currentTimeTTime == -1)
+			//seconds are counted from the start of the time trial, so late updates do not add up
+			while (gameState == ActiveGame && SDL_GetTicks() - currentTime >= 1000)
 			{
-				gameState = GameOver;
-				menuButton.gameState = TimeTrialMenu;
-				Update();
+				currentTime += 1000;
+				if (--currentTimeTTime == -1)
+				{
+					gameState = GameOver;
+					menuButton.gameState = TimeTrialMenu;
+					Update();
+				}
 			}
 		}
+		//the board is stored whenever a move ends, so leaving the level keeps it
+		if (LMB == JustUp && flowStart != NULL && playState.pack != NULL && !isTimeTrialGame)
+			StoreBoard(&boardStore, playState.pack, playState.levelIndex, board, EncodePlayState(&playState, board));
 		margin = (screen->w - GAME_AREA_SIZE) / 2;
 		if (InRect(margin, LEVEL_TILE_MARGIN_TOP, GAME_AREA_SIZE, GAME_AREA_SIZE, mousePosition))
 		{
 			//get clicked flow element
 			if(LMB == JustDown)
 			{
-				flowElementStart = NULL;
+				flowElementStart = NO_ELEMENT;
 				flowStart = NULL;
-				v.w = GAME_AREA_SIZE / currentLevels[currentLevelIndex].size; //flow element size
-				for (i = 0; i < currentLevels[currentLevelIndex].flowCount; i++)
+				v.w = GAME_AREA_SIZE / playState.size; //flow element size
+				owner = GetCellOwner(&playState,
+					(mousePosition.x - margin) / v.w, (mousePosition.y - LEVEL_TILE_MARGIN_TOP) / v.w);
+				if (owner != NULL && owner->element != NO_ELEMENT)
 				{
-					FOR_EACH(fElem1, currentLevels[currentLevelIndex].flows[i].firstElement)
-					{
-						if(InRect(fElem1->position.x * v.w + margin,
-							fElem1->position.y * v.w + LEVEL_TILE_MARGIN_TOP, v.w, v.w, mousePosition))
-						{
-							flowStart = &currentLevels[currentLevelIndex].flows[i];
-							flowElementStart = fElem1;
-							if (MakeRoute(flowElementStart->position.x, flowElementStart->position.y) == -1)
-								return -1; //memory error
-							UpdateShapes();
-							break;
-						}
-					}
+					flowStart = &playState.flows[owner->flow];
+					flowElementStart = owner->element;
+					if (playState.started == 0)
+						playState.started = SDL_GetTicks();
+					flowStartPosition.x = playState.elements[flowElementStart].x;
+					flowStartPosition.y = playState.elements[flowElementStart].y;
+					if (MakeRoute(flowStartPosition.x, flowStartPosition.y) == -1)
+						return -1; //memory error
+					UpdateShapes();
+					PostPlayHint(&playState);
+#ifndef NDEBUG
+					CheckLevelCounters(&playState);
+#endif
 				}
 			}
-			else if (LMB == Down && flowElementStart != NULL && flowStart != NULL)
+			else if (LMB == Down && flowElementStart != NO_ELEMENT && flowStart != NULL)
 			{
 				//convert mouse position to FlowElement posisiton
-				v.x = (double)(mousePosition.x - margin) / ((double)GAME_AREA_SIZE / currentLevels[currentLevelIndex].size);
-				v.y = (double)(mousePosition.y - LEVEL_TILE_MARGIN_TOP - 1) / ((double)GAME_AREA_SIZE / currentLevels[currentLevelIndex].size);
+				v.x = (double)(mousePosition.x - margin) / ((double)GAME_AREA_SIZE / playState.size);
+				v.y = (double)(mousePosition.y - LEVEL_TILE_MARGIN_TOP - 1) / ((double)GAME_AREA_SIZE / playState.size);
 				//connect FlowElements
 				if (MakeRoute(v.x, v.y) == -1)
 					return -1; //memory error
 				UpdateShapes();
-				//count completed Flows
-				completedFlowCount = 0;
-				innerFlowElementCount = 0;
-				for (i = 0; i < currentLevels[currentLevelIndex].flowCount; i++)
-				{
-					if (currentLevels[currentLevelIndex].flows[i].completed)
-						completedFlowCount++;
-					FOR_EACH(fElem1, currentLevels[currentLevelIndex].flows[i].firstElement)
-						innerFlowElementCount++;
-					innerFlowElementCount -= 2; //substract first and last
-				}
+				PostPlayHint(&playState);
+#ifndef NDEBUG
+				CheckLevelCounters(&playState);
+#endif
 				//check if game is over
-				if (currentLevels[currentLevelIndex].flowCount == completedFlowCount)
+				if (playState.flowCount == playState.completedFlowCount)
 				{
-					if (innerFlowElementCount + currentLevels[currentLevelIndex].flowCount * 2 ==
-						currentLevels[currentLevelIndex].size * currentLevels[currentLevelIndex].size)
-						currentLevels[currentLevelIndex].state = Starred;
-					else if (currentLevels[currentLevelIndex].state != Starred)
-						currentLevels[currentLevelIndex].state = Completed;
+					def = GetLevelDef(currentLevels, currentLevelIndex);
+					if (BitboardFull(&playState.occupied, playState.size))
+						state = Starred;
+					else
+						state = def->state == Starred ? Starred : Completed;
+					//the best time is journaled with the state, the pack is not rewritten
+					solveTime = GetSolveTime(&playState);
+					timeRecord = def->timeRecord == 0 || solveTime < def->timeRecord ? solveTime : def->timeRecord;
+					if (state != def->state || timeRecord != def->timeRecord)
+					{
+						SetLevelProgress(currentLevels, currentLevelIndex, state, timeRecord);
+						if (currentLevels == &defaultLevels)
+							PostProgress(&autosave, currentLevelIndex, state, timeRecord);
+					}
 					Draw(); //draw the last connection
 					if (isTimeTrialGame)
 					{
 						currentTimeTScore++;
-						SetCurrentLevel(rand() % defaultLevelCount);
+						SetCurrentLevel(rand() % defaultLevels.count);
 					}
 					else
 					{
+						RemoveStoredBoard(&boardStore, currentLevels, currentLevelIndex);
 						gameState = GameOver;
 						Update();
 						screenBlurred = 0;
@@ -1176,27 +1658,31 @@ int Update()
 		if (!isTimeTrialGame)
 		{
 			//reload level button
-			if (currentLevels[currentLevelIndex].state != Starred && IsButtonClicked(&reload))
+			if (GetLevelDef(currentLevels, currentLevelIndex)->state != Starred && IsButtonClicked(&reload))
 			{
 				gameState = reload.gameState;
 				reload.picture = reload.pictureDefault;
 				SetCurrentLevel(currentLevelIndex);
 			}
 			//next level button
-			if (currentLevelIndex != currentLevelCount - 1 && IsButtonClicked(&arrowNext))
+			if (currentLevelIndex != currentLevels->count - 1 && IsButtonClicked(&arrowNext))
 			{
 				SetCurrentLevel(currentLevelIndex + 1);
-				currentLevelSelectPage = (currentLevelIndex + 1) / 10;
+				if ((i = GetCatalogIndex(&catalog, currentLevels, currentLevelIndex)) != -1)
+					currentLevelSelectPage = i / 9;
 				gameState = arrowNext.gameState;
 				Update();
 			}
 		}
 		else if (timeTHighScores[timeTScoreIndex] < currentTimeTScore)
+		{
 			timeTHighScores[timeTScoreIndex] = currentTimeTScore;
+			PostScores(&autosave, timeTHighScores);
+		}
 		break;
 
 	case TimeTrialMenu:
-		currentLevels = defaultLevels;
+		currentLevels = &defaultLevels;
 		arrowBack.gameState = MainMenu;
 		isTimeTrialGame = 0;
 		if (IsButtonClicked(&arrowBack))
@@ -1216,11 +1702,12 @@ int Update()
 					gameState = ActiveGame;
 					timeTrialMenuItems[i].mouseDown = 0;
 					timeTrialMenuItems[i].mouseOver = 0;
-					currentTimeTTime = timeTrialMenuItems[i].time + 1;
+					currentTimeTTime = timeTrialMenuItems[i].time;
+					currentTime = SDL_GetTicks();
 					timeTScoreIndex = timeTrialMenuItems[i].index;
 					isTimeTrialGame = 1;
 					currentTimeTScore = 0;
-					SetCurrentLevel(rand() % defaultLevelCount);
+					SetCurrentLevel(rand() % defaultLevels.count);
 					arrowBack.gameState = TimeTrialMenu;
 					Update();
 				}
@@ -1237,40 +1724,20 @@ int Update()
 	case UserLevelLoading:
 		if (loadUserLevel)
 		{
-			FILE *file;
 			loadUserLevel = 0;
 			menuButton.gameState = MainMenu;
-			if ((file = fopen("userLevels.txt", "rt")) == NULL)
-			{
-				userLevelError = "\"userLevels.txt\" could not be loaded.";
-				userLevels = NULL;
-				userLevelCount = 0;
-			}
-			else
-			{
-				if (userLevels) //free previously loaded currentLevels
-				{
-					for (i = 0; i < userLevelCount; i++)
-						FreeLevelContent(&userLevels[i]);
-					free(userLevels);
-				}
-				LoadLevelsFromFile(file, &userLevels, &userLevelCount);
-				if (!userLevels)
-					userLevelError = "\"userLevels.txt\" contains wrong format.";
-				else
-				{
-					currentLevels = userLevels;
-					currentLevelCount = userLevelCount;
-					SetCurrentLevel(0);
-					loadUserLevel = 1;
-					gameState = ActiveGame;
-					Update();
-				}
-				fclose(file);
-			}
 			screenBlurred = 0;
 		}
-		if (IsButtonClicked(&menuButton))
+		//the levels are parsed by userLevelWatch, this waits for them or shows the error
+		if (userLevelError == NULL && userLevels.count > 0)
+		{
+			currentLevels = &userLevels;
+			SetCurrentLevel(0);
+			loadUserLevel = 1;
+			gameState = ActiveGame;
+			Update();
+		}
+		else if (IsButtonClicked(&menuButton))
 		{
 			gameState = menuButton.gameState;
 			loadUserLevel = 1;
@@ -1309,8 +1776,11 @@ void Draw()
 {
 	SDL_Color white = {255,255,255};
 	SDL_Color black = {0,0,0};
-	char str[60];
-	int i, j, k, textW, textH, margin;
+	char str[60], *message;
+	int i, j, k, e, textW, textH, margin, fromX, fromY, toX, toY;
+	Uint32 best;
+	HintResult hint;
+	LevelPack *pack;
 	SDL_Rect r = {0, 0, 0, 0};
 	Flow *f;
 	FlowElement *fElem1;
@@ -1359,6 +1829,14 @@ void Draw()
 
 		//current/all LevelTile page
 		*str = 0;
+		if (catalog.packCount > 1)
+		{
+			sprintf(str, "%.40s", catalog.names[FindCatalogPack(&catalog, currentLevelSelectPage * 9)]);
+			TTF_SizeText(fontSmall, str, &textW, &textH);
+			r.x = screen->w / 2 - textW / 2;
+			r.y = LEVEL_TILE_MARGIN_TOP - 30 - textH;
+			DrawString(screen, r, fontSmall, str, white, black);
+		}
 		sprintf(str, "%d/%d", currentLevelSelectPage + 1, levelSelectPageCount);
 		TTF_SizeText(fontSmall, str, &textW, NULL);
 		r.x = screen->w / 2 - textW / 2;
@@ -1396,11 +1874,12 @@ void Draw()
 					r.y -= (LEVEL_TILE_SIZE - textH) / 2;
 				}
 				//level complete indicator
-				if (i * 3 + j + currentLevelSelectPage * 9 < currentLevelCount)
+				if (i * 3 + j + currentLevelSelectPage * 9 < catalog.count)
 				{
 					r.x += LEVEL_TILE_SIZE - cMarkPic->w - 3;
 					r.y += LEVEL_TILE_SIZE - cMarkPic->h - 3;
-					switch (currentLevels[i * 3 + j + currentLevelSelectPage * 9].state)
+					pack = FindCatalogLevel(&catalog, i * 3 + j + currentLevelSelectPage * 9, &k);
+					switch (GetLevelDef(pack, k)->state)
 					{
 					case Completed:
 						SDL_BlitSurface(cMarkPic, 0, screen, &r);
@@ -1439,7 +1918,7 @@ void Draw()
 				SDL_BlitSurface(arrowPrev.picture, 0, screen, &r);
 			}
 			//next currentLevels button
-			if (currentLevelIndex != currentLevelCount - 1)
+			if (currentLevelIndex != currentLevels->count - 1)
 			{
 				r.x = arrowNext.position.x;
 				r.y = arrowNext.position.y;
@@ -1470,7 +1949,7 @@ void Draw()
 		margin = (screen->w - GAME_AREA_SIZE)/2;
 		//comleted/all flow count
 		*str = 0;
-		sprintf(str, "flows: %d/%d", completedFlowCount, currentLevels[currentLevelIndex].flowCount);
+		sprintf(str, "flows: %d/%d", playState.completedFlowCount, playState.flowCount);
 		TTF_SizeText(fontSmall, str, &textW, &textH);
 		r.x = margin;
 		r.y = LEVEL_TILE_MARGIN_TOP - textH - 10;
@@ -1478,15 +1957,16 @@ void Draw()
 		//percent
 		*str = 0;
 		sprintf(str, "%d%%",
-			(int)((double)(innerFlowElementCount + completedFlowCount) * 100.0 /
-			(double)(currentLevels[currentLevelIndex].size * currentLevels[currentLevelIndex].size - currentLevels[currentLevelIndex].flowCount)));
+			(int)((double)(playState.innerFlowElementCount +
+			playState.completedFlowCount) * 100.0 /
+			(double)(playState.size * playState.size - playState.flowCount)));
 		r.x = margin + 100;
 		r.y = LEVEL_TILE_MARGIN_TOP - textH - 10;
 		DrawString(screen, r, fontSmall, str, white, black);
 		//currentLevels state
 		r.x = screen->w - cMarkPic->w - 10;
 		r.y = 30;
-		switch (currentLevels[currentLevelIndex].state)
+		switch (GetLevelDef(currentLevels, currentLevelIndex)->state)
 		{
 		case Completed:
 			SDL_BlitSurface(cMarkPic, 0, screen, &r);
@@ -1498,41 +1978,42 @@ void Draw()
 			break;
 		}
 		//horizontal grid
-		for (i = 0; i <= currentLevels[currentLevelIndex].size; i++)
+		for (i = 0; i <= playState.size; i++)
 		{
 			r.x = margin - GAME_AREA_GRID_WIDTH;
-			r.w = GAME_AREA_GRID_WIDTH + currentLevels[currentLevelIndex].size *
-				((GAME_AREA_SIZE - (currentLevels[currentLevelIndex].size - 1) *
-				GAME_AREA_GRID_WIDTH) / currentLevels[currentLevelIndex].size + GAME_AREA_GRID_WIDTH) - 1;
+			r.w = GAME_AREA_GRID_WIDTH + playState.size *
+				((GAME_AREA_SIZE - (playState.size - 1) *
+				GAME_AREA_GRID_WIDTH) / playState.size + GAME_AREA_GRID_WIDTH) - 1;
 			r.y = LEVEL_TILE_MARGIN_TOP - GAME_AREA_GRID_WIDTH + 
-				i * ((GAME_AREA_SIZE - (currentLevels[currentLevelIndex].size - 1) *
-				GAME_AREA_GRID_WIDTH) / currentLevels[currentLevelIndex].size + GAME_AREA_GRID_WIDTH);
+				i * ((GAME_AREA_SIZE - (playState.size - 1) *
+				GAME_AREA_GRID_WIDTH) / playState.size + GAME_AREA_GRID_WIDTH);
 			r.h = GAME_AREA_GRID_WIDTH - 1;
 			boxColor(screen, r.x, r.y, r.x + r.w, r.y + r.h, SDLColorTo32bit(GAME_AREA_GRID_COLOR));
 		}
 		//vertical grid
-		for (i = 0; i <= currentLevels[currentLevelIndex].size; i++)
+		for (i = 0; i <= playState.size; i++)
 		{
 			r.x = margin - GAME_AREA_GRID_WIDTH +
-				i * ((GAME_AREA_SIZE - (currentLevels[currentLevelIndex].size - 1) *
-				GAME_AREA_GRID_WIDTH) / currentLevels[currentLevelIndex].size + GAME_AREA_GRID_WIDTH);
+				i * ((GAME_AREA_SIZE - (playState.size - 1) *
+				GAME_AREA_GRID_WIDTH) / playState.size + GAME_AREA_GRID_WIDTH);
 			r.w = GAME_AREA_GRID_WIDTH - 1;
 			r.y = LEVEL_TILE_MARGIN_TOP - GAME_AREA_GRID_WIDTH;
 			r.h = GAME_AREA_SIZE + GAME_AREA_GRID_WIDTH - 1;
 			boxColor(screen, r.x, r.y, r.x + r.w, r.y + r.h, SDLColorTo32bit(GAME_AREA_GRID_COLOR));
 		}
 		//Flows
-		r.w = (GAME_AREA_SIZE - (currentLevels[currentLevelIndex].size - 1) * GAME_AREA_GRID_WIDTH) / currentLevels[currentLevelIndex].size - 1;
+		r.w = (GAME_AREA_SIZE - (playState.size - 1) * GAME_AREA_GRID_WIDTH) / playState.size - 1;
 		r.h = r.w;
 		i = r.w * FLOW_SIZE_PERCENT / 100.0; //current flow width
 		j = r.w * FLOW_END_SIZE_PERCENT / 100.0; //current flow end width
-		for (k = 0; k < currentLevels[currentLevelIndex].flowCount; k++)
+		for (k = 0; k < playState.flowCount; k++)
 		{
-			f = &currentLevels[currentLevelIndex].flows[k];
-			FOR_EACH(fElem1, currentLevels[currentLevelIndex].flows[k].firstElement)
+			f = &playState.flows[k];
+			FOR_EACH(e, f->firstElement, playState.elements)
 			{
-				r.x = fElem1->position.x * (r.w + GAME_AREA_GRID_WIDTH + 1) + margin;
-				r.y = fElem1->position.y * (r.w + GAME_AREA_GRID_WIDTH + 1) + LEVEL_TILE_MARGIN_TOP;
+				fElem1 = &playState.elements[e];
+				r.x = fElem1->x * (r.w + GAME_AREA_GRID_WIDTH + 1) + margin;
+				r.y = fElem1->y * (r.w + GAME_AREA_GRID_WIDTH + 1) + LEVEL_TILE_MARGIN_TOP;
 				boxColor(screen, r.x, r.y, r.x + r.w, r.y + r.h, SetOpacity(SDLColorTo32bit(f->color), FLOW_BG_OPACITY));
 				if (fElem1->shape & UpS)
 				{
@@ -1564,9 +2045,52 @@ void Draw()
 				}
 			}
 		}
-		//print level name
+		//while h is held the next segment of a solution is shown and the paths that are in none are dimmed
+		if (!isTimeTrialGame)
+		{
+			GetHint(&hintEngine, &hint);
+			message = !KeysDown[SDLK_h] ? "hold h for a hint" :
+				hint.state == HintSearching ? "searching..." : hint.state == HintUnavailable ? "no hint" : "";
+			TTF_SizeText(fontSmall, message, &textW, &textH);
+			r.x = margin + GAME_AREA_SIZE - textW;
+			r.y = LEVEL_TILE_MARGIN_TOP - textH - 10;
+			DrawString(screen, r, fontSmall, message, white, black);
+			r.w = (GAME_AREA_SIZE - (playState.size - 1) * GAME_AREA_GRID_WIDTH) / playState.size - 1;
+			r.h = r.w;
+			for (k = 0; KeysDown[SDLK_h] && k < playState.flowCount && k < SOLVER_MAX_FLOWS; k++)
+			{
+				if ((hint.inconsistent & (Uint64)1 << k) == 0)
+					continue;
+				f = &playState.flows[k];
+				FOR_EACH(e, playState.elements[f->firstElement].next, playState.elements)
+				{
+					if (e == f->lastElement)
+						break;
+					fElem1 = &playState.elements[e];
+					r.x = fElem1->x * (r.w + GAME_AREA_GRID_WIDTH + 1) + margin;
+					r.y = fElem1->y * (r.w + GAME_AREA_GRID_WIDTH + 1) + LEVEL_TILE_MARGIN_TOP;
+					boxColor(screen, r.x + (r.w - j) / 2, r.y + (r.h - j) / 2, r.x + (r.w - j) / 2 + j,
+						r.y + (r.h - j) / 2 + j, SetOpacity(SDLColorTo32bit(black), 70));
+				}
+			}
+			if (KeysDown[SDLK_h] && hint.state == HintFound && hint.flow < playState.flowCount)
+			{
+				//a thin line from the end of the path to the center of the next cell
+				fromX = hint.from % playState.size * (r.w + GAME_AREA_GRID_WIDTH + 1) + margin + r.w / 2;
+				fromY = hint.from / playState.size * (r.w + GAME_AREA_GRID_WIDTH + 1) + LEVEL_TILE_MARGIN_TOP + r.h / 2;
+				toX = hint.to % playState.size * (r.w + GAME_AREA_GRID_WIDTH + 1) + margin + r.w / 2;
+				toY = hint.to / playState.size * (r.w + GAME_AREA_GRID_WIDTH + 1) + LEVEL_TILE_MARGIN_TOP + r.h / 2;
+				boxColor(screen, (fromX < toX ? fromX : toX) - i / 4, (fromY < toY ? fromY : toY) - i / 4,
+					Max(fromX, toX) + i / 4, Max(fromY, toY) + i / 4, SDLColorTo32bit(white));
+				boxColor(screen, toX - i / 2, toY - i / 2, toX + i / 2, toY + i / 2,
+					SDLColorTo32bit(playState.flows[hint.flow].color));
+			}
+		}
+		//print level name, the number of the level in the level select if it is there
 		*str = 0;
-		sprintf(str, "level %d", currentLevelIndex + 1);
+		if ((i = GetCatalogIndex(&catalog, currentLevels, currentLevelIndex)) == -1)
+			i = currentLevelIndex;
+		sprintf(str, "level %d", i + 1);
 		r.x = 50;
 		r.y = 0;
 		DrawString(screen, r, fontNormal, str, white, black);
@@ -1585,7 +2109,7 @@ void Draw()
 		SDL_BlitSurface(menuButton.picture, 0, screen, &r);
 		if (!isTimeTrialGame)
 		{
-			if (currentLevels[currentLevelIndex].state != Starred)
+			if (GetLevelDef(currentLevels, currentLevelIndex)->state != Starred)
 			{
 				TTF_SizeText(fontSmall, "fill the whole game area.", &textW, &textH);
 				r.y = arrowNext.position.y - arrowNext.picture->h - textH;
@@ -1611,12 +2135,19 @@ void Draw()
 				r.y = arrowNext.position.y - arrowNext.picture->h - textH;
 				DrawString(screen, r, fontNormal, "completed", white, black);
 			}
-			if (currentLevelIndex != currentLevelCount - 1)
+			if (currentLevelIndex != currentLevels->count - 1)
 			{
 				r.x = arrowNext.position.x;
 				r.y = arrowNext.position.y;
 				SDL_BlitSurface(arrowNext.picture, 0, screen, &r);
 			}
+			//solve time and best time
+			best = GetLevelDef(currentLevels, currentLevelIndex)->timeRecord;
+			sprintf(str, "time: %u.%03u s, best: %u.%03u s", solveTime / 1000, solveTime % 1000, best / 1000, best % 1000);
+			TTF_SizeText(fontSmall, str, &textW, &textH);
+			r.x = screen->w / 2 - textW / 2;
+			r.y = arrowNext.position.y + arrowNext.picture->h + 10;
+			DrawString(screen, r, fontSmall, str, white, black);
 		}
 		else
 		{
@@ -1644,10 +2175,11 @@ void Draw()
 		r.x = menuButton.position.x;
 		r.y = menuButton.position.y;
 		SDL_BlitSurface(menuButton.picture, 0, screen, &r);
-		TTF_SizeText(fontSmall, userLevelError, &textW, &textH);
+		message = userLevelError != NULL ? userLevelError : "Loading \"userLevels.txt\"...";
+		TTF_SizeText(fontSmall, message, &textW, &textH);
 		r.y = arrowNext.position.y - arrowNext.picture->h - textH;
 		r.x = screen->w / 2 - textW / 2;
-		DrawString(screen, r, fontSmall, userLevelError, white, black);
+		DrawString(screen, r, fontSmall, message, white, black);
 		break;
 
 	case TimeTrialMenu:
@@ -1738,6 +2270,7 @@ Uint32 SendUserEventTick(Uint32 ms, void* param)
 int LoadResources()
 {
 	FILE *file;
+	int line, column;
 	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
 	{
 		printf( "Unable to init SDL: %s\n", SDL_GetError());
@@ -1820,21 +2353,36 @@ int LoadResources()
 		printf("Unable to load bitmap: %s\n", SDL_GetError());
 		return -1;
 	}
-	//Load default currentLevels
-	if ((file = fopen("defaultLevels.txt", "rt")) == NULL)
+	//Load default currentLevels, the binary pack is preferred, both are decoded on demand
+	if (OpenLevelPack("defaultLevels.pack", &defaultLevels) == -1 &&
+		OpenTextLevelPack("defaultLevels.txt", &defaultLevels, &line, &column) == -1)
 	{
-		printf("Unable to load currentLevels\n");
+		if (line == 0)
+			printf("Unable to load currentLevels\n");
+		else
+			printf("Unable to parse currentLevels at line %d, column %d\n", line, column);
 		return -1;
 	}
-	defaultLevels = NULL;
-	LoadLevelsFromFile(file, &defaultLevels, &defaultLevelCount);
-	if (!defaultLevels)
+	//the progress is kept apart from the levels, a game without it is still playable
+	if (OpenProgressJournal(&progressJournal, "progress.journal", &defaultLevels) == -1)
+		printf("Unable to open the progress journal\n");
+	//the boards left unfinished, each is checked against its level when it is restored
+	LoadBoardStore(&boardStore, "boards.dat", &defaultLevels);
+	//the packs of the levels directory follow the default levels in the level select
+	if (LoadLevelCatalog(&catalog, "levels", &defaultLevels, "default") == -1)
 	{
-		printf("Unable to parse currentLevels\n");
-		fclose(file);
+		printf("Unable to load the level packs\n");
 		return -1;
 	}
-	fclose(file);
+	//changes are written on their own thread from now on
+	if (StartAutosave(&autosave, &progressJournal, "scores.txt") == -1)
+		printf("Unable to start autosaving, changes are written right away\n");
+	//user levels are parsed on their own thread and again whenever the file changes
+	if (StartLevelWatch(&userLevelWatch, "userLevels.txt") == -1)
+		printf("Unable to watch the user levels, they are only loaded once\n");
+	//hints are searched on their own thread, the game does not wait for them
+	if (StartHintEngine(&hintEngine) == -1)
+		printf("Unable to start the hint engine, there are no hints\n");
 	//load time trial high scores
 	timeTHighScores[0] = 0;
 	timeTHighScores[1] = 0;
@@ -1854,26 +2402,25 @@ int LoadResources()
 /// </summary>
 void UnloadResources()
 {
-	int i;
 	SDL_RemoveTimer(userTimer);
+	StopHintEngine(&hintEngine);
 	SDL_FreeSurface(starPic);
 	SDL_FreeSurface(cMarkPic);
 	SDL_FreeSurface(screen);
 	TTF_CloseFont(fontTitle);
 	TTF_CloseFont(fontNormal);
 	TTF_CloseFont(fontSmall);
-	if (userLevels)
-	{
-		for (i = 0; i < userLevelCount; i++)
-			FreeLevelContent(&userLevels[i]);
-		free(userLevels);
-	}
-	if (defaultLevels)
-	{
-		for (i = 0; i < defaultLevelCount; i++)
-			FreeLevelContent(&defaultLevels[i]);
-		free(defaultLevels);
-	}
+	FreePlayState(&playState);
+	if (SaveBoardStore(&boardStore, "boards.dat", &defaultLevels) == -1)
+		printf("Unable to save the unfinished boards\n");
+	FreeBoardStore(&boardStore);
+	StopAutosave(&autosave); //writes what is still queued
+	CloseProgressJournal(&progressJournal);
+	StopLevelWatch(&userLevelWatch);
+	FreeLevelPack(&userLevels);
+	free(userLevelHashes);
+	FreeLevelCatalog(&catalog);
+	FreeLevelPack(&defaultLevels);
 }
 
 /// <summary>
@@ -1890,12 +2437,10 @@ int Init()
 	gameState = MainMenu;
 	exiting = 0;
 	loadUserLevel = 1;
-	currentLevels = defaultLevels;
-	userLevels = NULL;
-	currentLevelCount = defaultLevelCount;
+	currentLevels = &defaultLevels;
 	currentLevelIndex = 0;
 	currentLevelSelectPage = 0;
-	levelSelectPageCount = 1 + (defaultLevelCount - 1 ) / 9;
+	levelSelectPageCount = 1 + (catalog.count - 1 ) / 9;
 	aboutAnimation = 0;
 	isTimeTrialGame = 0;
 	currentTime = SDL_GetTicks();
@@ -1926,42 +2471,34 @@ int Init()
 	return 0;
 }
 
-/// <summary>
-/// Saves the loaded levels to file.
-/// </summary>
-void Save()
-{
-	FILE *file;
-	int i, j;
-	if ((file = fopen("defaultLevels.txt", "wt")) != NULL)
-	{
-		for (i = 0; i < defaultLevelCount; i++)
-		{
-			fprintf(file, "{");
-			for (j = 0; j < defaultLevels[i].flowCount; j++)
-			{
-				fprintf(file, "{%d,%d,%d,%d},",
-					defaultLevels[i].flows[j].firstElement->position.x + 1,
-					defaultLevels[i].flows[j].firstElement->position.y + 1,
-					defaultLevels[i].flows[j].lastElement->position.x + 1,
-					defaultLevels[i].flows[j].lastElement->position.y + 1);
-			}
-			if (i == defaultLevelCount - 1)
-				fprintf(file, "%d,%d,0}", defaultLevels[i].size, defaultLevels[i].state);
-			else
-				fprintf(file, "%d,%d,0}\n", defaultLevels[i].size, defaultLevels[i].state);
-		}
-		fclose(file);
-	}
-	if ((file = fopen("scores.txt", "wt")) != NULL)
-	{
-		fprintf(file, "%d,%d,%d", timeTHighScores[0], timeTHighScores[1], timeTHighScores[2]);
-		fclose(file);
-	}
-}
-
 int main(int argc, char* argv[])
 {
+#ifdef FLOW_TESTS
+	int result;
+	//benchmarks and tests, only built with FLOW_TESTS defined, see benchmarks.h and selftests.h
+	if ((result = RunBenchmark(argc, argv)) != -1 || (result = RunSelfTest(argc, argv)) != -1)
+		return result;
+#endif
+	//level converter: Flow --convert defaultLevels.txt defaultLevels.pack, or back to text,
+	//Flow --compress for a compressed pack and Flow --import grids.txt grids.pack for ASCII grids,
+	//Flow --solve levels.txt [threads] checks that every level of a pack can be solved,
+	//Flow --count levels.txt [threads] counts the solutions of every level, Flow --sat levels.txt solves them
+	//with the SAT solver, Flow --dimacs levels.txt 5 level5.cnf writes the clauses of a level
+	//and Flow --unique levels.txt [threads] checks that every level has a single solution
+	if (argc == 4 && strcmp(argv[1], "--convert") == 0)
+		return ConvertLevels(argv[2], argv[3], 0) == -1 ? 1 : 0;
+	if (argc == 4 && strcmp(argv[1], "--compress") == 0)
+		return ConvertLevels(argv[2], argv[3], 1) == -1 ? 1 : 0;
+	if (argc == 4 && strcmp(argv[1], "--import") == 0)
+		return ImportLevels(argv[2], argv[3]) == -1 ? 1 : 0;
+	if ((argc == 3 || argc == 4) && (strcmp(argv[1], "--solve") == 0 || strcmp(argv[1], "--count") == 0))
+		return SolveLevels(argv[2], argc == 4 ? atoi(argv[3]) : GetProcessorCount(), strcmp(argv[1], "--count") == 0) == -1 ? 1 : 0;
+	if (argc == 3 && strcmp(argv[1], "--sat") == 0)
+		return SolveLevelsSat(argv[2]) == -1 ? 1 : 0;
+	if (argc == 5 && strcmp(argv[1], "--dimacs") == 0)
+		return ExportLevelCnf(argv[2], atoi(argv[3]), argv[4]) == -1 ? 1 : 0;
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--unique") == 0)
+		return CheckPackUniqueness(argv[2], argc == 4 ? atoi(argv[3]) : GetProcessorCount()) == -1 ? 1 : 0;
 	if(LoadResources() == -1)
 		return 1;
 	atexit(UnloadResources);
@@ -1977,6 +2514,5 @@ int main(int argc, char* argv[])
 			return 1;
 		Draw();
 	}
-	Save();
 	return 0;
 }
\ No newline at end of file
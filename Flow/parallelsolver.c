@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "parallelsolver.h"
+
+/// <summary>
+/// Stops the workers of a search, the lock of the search is held.
+/// </summary>
+/// <param name="parallel">The search.</param>
+void CancelParallelSolver(ParallelSolver *parallel)
+{
+	AtomicStore(&parallel->cancelled, 1);
+	SDL_CondBroadcast(parallel->changed);
+}
+
+/// <summary>
+/// Queues a task on the deque of a worker.
+/// </summary>
+/// <param name="worker">The worker.</param>
+/// <param name="state">The state of the task.</param>
+/// <param name="depth">The number of branches taken to the state.</param>
+void PushSolverTask(SolverWorker *worker, const SolverState *state, int depth)
+{
+	ParallelSolver *parallel = worker->parallel;
+	SolverDeque *deque = &worker->deque;
+	//counted first, so that the search cannot seem over while the task is queued
+	SDL_LockMutex(parallel->lock);
+	parallel->queued++;
+	parallel->pending++;
+	SDL_CondSignal(parallel->changed);
+	SDL_UnlockMutex(parallel->lock);
+	SDL_LockMutex(deque->lock);
+	deque->tasks[deque->bottom % PARALLELSOLVER_DEQUE_SIZE].state = *state;
+	deque->tasks[deque->bottom % PARALLELSOLVER_DEQUE_SIZE].depth = depth;
+	deque->bottom++;
+	SDL_UnlockMutex(deque->lock);
+}
+
+/// <summary>
+/// Takes a task from a deque.
+/// </summary>
+/// <param name="deque">The deque.</param>
+/// <param name="newest">1 to take the newest task, as the worker of the deque does, 0 to steal the oldest.</param>
+/// <param name="state">Set to the state of the task.</param>
+/// <param name="depth">Set to the number of branches taken to the state.</param>
+/// <returns>Returns 1 if a task was taken, 0 if the deque is empty.</returns>
+int TakeSolverTask(SolverDeque *deque, int newest, SolverState *state, int *depth)
+{
+	SolverTask *task;
+	SDL_LockMutex(deque->lock);
+	if (deque->top == deque->bottom)
+	{
+		SDL_UnlockMutex(deque->lock);
+		return 0;
+	}
+	task = &deque->tasks[(newest ? --deque->bottom : deque->top++) % PARALLELSOLVER_DEQUE_SIZE];
+	*state = task->state;
+	*depth = task->depth;
+	SDL_UnlockMutex(deque->lock);
+	return 1;
+}
+
+/// <summary>
+/// Runs a task: a state close to the start of the level is split into a task per branch,
+/// a deeper one is searched to the end.
+/// </summary>
+/// <param name="worker">The worker, the state of the task is first in the stack of its solver.</param>
+/// <param name="depth">The number of branches taken to the state.</param>
+void RunSolverTask(SolverWorker *worker, int depth)
+{
+	ParallelSolver *parallel = worker->parallel;
+	Solver *solver = &worker->solver;
+	int moves[4], end, moveCount, i, result = 0;
+	solver->solutions = 0;
+	if (depth < PARALLELSOLVER_SPLIT_DEPTH)
+	{
+		solver->nodes++;
+		if ((moveCount = BranchSolverState(solver, &solver->stack[0], &end, moves)) == -1)
+			return;
+		//queued from the last to the first branch, so that the worker takes them in order
+		for (i = moveCount - 1; i >= 0; i--)
+		{
+			solver->stack[1] = solver->stack[0];
+			MoveSolverEnd(solver, &solver->stack[1], end, moves[i]);
+			PushSolverTask(worker, &solver->stack[1], depth + 1);
+		}
+		if (moveCount > 0)
+			return;
+		solver->solutions = 1;
+		WriteLevelSolution(solver, &solver->stack[0], &worker->solution);
+	}
+	else
+		result = SearchSolver(solver, 0, &worker->solution);
+	SDL_LockMutex(parallel->lock);
+	//a search stopped by another worker is not a worker giving up
+	if (result == -1 && !AtomicLoad(&parallel->cancelled))
+	{
+		parallel->result = -1;
+		CancelParallelSolver(parallel);
+	}
+	if (solver->solutions > 0)
+	{
+		if (parallel->solutions == 0)
+			*parallel->solution = worker->solution;
+		parallel->solutions += solver->solutions;
+		if (parallel->solutionLimit != 0 && parallel->solutions >= parallel->solutionLimit)
+			CancelParallelSolver(parallel);
+	}
+	SDL_UnlockMutex(parallel->lock);
+}
+
+/// <summary>
+/// Runs the tasks of a search until there are none left or the search is cancelled,
+/// each worker thread runs this. A worker without tasks steals from the others.
+/// </summary>
+/// <param name="data">The worker.</param>
+/// <returns>Returns 0.</returns>
+int RunSolverWorker(void *data)
+{
+	SolverWorker *worker = (SolverWorker *)data;
+	ParallelSolver *parallel = worker->parallel;
+	Solver *solver = &worker->solver;
+	int depth, i, found, over = 0;
+	while (!over && !AtomicLoad(&parallel->cancelled))
+	{
+		found = TakeSolverTask(&worker->deque, 1, &solver->stack[0], &depth);
+		for (i = 1; !found && i < parallel->workerCount; i++)
+			found = TakeSolverTask(&parallel->workers[(worker->index + i) % parallel->workerCount].deque, 0,
+				&solver->stack[0], &depth);
+		SDL_LockMutex(parallel->lock);
+		if (found)
+		{
+			parallel->queued--;
+			SDL_UnlockMutex(parallel->lock);
+			RunSolverTask(worker, depth);
+			SDL_LockMutex(parallel->lock);
+			if (--parallel->pending == 0)
+				SDL_CondBroadcast(parallel->changed);
+		}
+		else
+		{
+			//the tasks being run may still queue more
+			while (parallel->queued == 0 && parallel->pending > 0 && !AtomicLoad(&parallel->cancelled))
+				SDL_CondWait(parallel->changed, parallel->lock);
+			over = parallel->pending == 0;
+		}
+		SDL_UnlockMutex(parallel->lock);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Searches a level on the workers of a search, the main thread being one of them.
+/// </summary>
+/// <param name="parallel">The search, its solutions are counted.</param>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="nodeLimit">The number of branches every worker tries before giving up, 0 for no limit.</param>
+/// <param name="strict">1 if paths may not run next to themselves.</param>
+/// <returns>Returns -1 if a worker gave up or on error, 0 otherwise.</returns>
+int RunParallelSolver(ParallelSolver *parallel, const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, int strict)
+{
+	SDL_Thread *threads[PARALLELSOLVER_MAX_WORKERS];
+	SolverWorker *worker;
+	int i, threadCount;
+	for (i = 0; i < parallel->workerCount && InitSolver(&parallel->workers[i].solver, def, endpoints, nodeLimit) == 0; i++)
+	{
+		worker = &parallel->workers[i];
+		worker->solver.solutionLimit = parallel->solutionLimit;
+		worker->solver.cancel = &parallel->cancelled;
+		worker->solver.strict = strict;
+		worker->deque.top = worker->deque.bottom = 0;
+	}
+	if (i < parallel->workerCount)
+	{
+		while (i > 0)
+			FreeSolver(&parallel->workers[--i].solver);
+		return -1;
+	}
+	parallel->queued = parallel->pending = 0;
+	parallel->result = 0;
+	parallel->solutions = 0;
+	AtomicStore(&parallel->cancelled, 0);
+	//the start of the level is the first task, the workers split it further
+	worker = &parallel->workers[0];
+	PushSolverTask(worker, &worker->solver.stack[0], 0);
+	//a worker without a thread has nothing queued to steal
+	for (threadCount = 0; threadCount < parallel->workerCount - 1; threadCount++)
+		if ((threads[threadCount] = SDL_CreateThread(RunSolverWorker, &parallel->workers[threadCount + 1])) == NULL)
+			break;
+	RunSolverWorker(worker);
+	for (i = 0; i < threadCount; i++)
+		SDL_WaitThread(threads[i], NULL);
+	for (i = 0; i < parallel->workerCount; i++)
+		FreeSolver(&parallel->workers[i].solver);
+	return parallel->result;
+}
+
+/// <summary>
+/// Frees a search.
+/// </summary>
+/// <param name="parallel">The search.</param>
+void FreeParallelSolver(ParallelSolver *parallel)
+{
+	int i;
+	for (i = 0; i < parallel->workerCount; i++)
+		SDL_DestroyMutex(parallel->workers[i].deque.lock);
+	if (parallel->lock != NULL)
+		SDL_DestroyMutex(parallel->lock);
+	if (parallel->changed != NULL)
+		SDL_DestroyCond(parallel->changed);
+	free(parallel);
+}
+
+/// <summary>
+/// Creates a search with its workers.
+/// </summary>
+/// <param name="workerCount">The number of threads, limited to PARALLELSOLVER_MAX_WORKERS.</param>
+/// <param name="solutionLimit">The number of solutions to find before stopping, 0 to count them all.</param>
+/// <param name="solution">The first solution found.</param>
+/// <returns>Returns the search, NULL on error.</returns>
+ParallelSolver *CreateParallelSolver(int workerCount, Uint32 solutionLimit, LevelSolution *solution)
+{
+	ParallelSolver *parallel;
+	int i;
+	//the workers are too large for the stack of a thread
+	if ((parallel = (ParallelSolver *)calloc(1, sizeof(ParallelSolver))) == NULL)
+		return NULL;
+	parallel->workerCount = workerCount < 1 ? 1 : workerCount > PARALLELSOLVER_MAX_WORKERS ? PARALLELSOLVER_MAX_WORKERS : workerCount;
+	parallel->solutionLimit = solutionLimit;
+	parallel->solution = solution;
+	parallel->lock = SDL_CreateMutex();
+	parallel->changed = SDL_CreateCond();
+	for (i = 0; i < parallel->workerCount; i++)
+	{
+		parallel->workers[i].parallel = parallel;
+		parallel->workers[i].index = i;
+		if ((parallel->workers[i].deque.lock = SDL_CreateMutex()) == NULL)
+			break;
+	}
+	if (i < parallel->workerCount || parallel->lock == NULL || parallel->changed == NULL)
+	{
+		parallel->workerCount = i;
+		FreeParallelSolver(parallel);
+		return NULL;
+	}
+	return parallel;
+}
+
+/// <summary>
+/// Finds a solution of a level that fills the whole board, as SolveLevel does, on a pool of worker threads.
+/// </summary>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="nodeLimit">The number of branches every worker tries before giving up, 0 for no limit.</param>
+/// <param name="workerCount">The number of threads.</param>
+/// <param name="solution">The solution, set if one is found.</param>
+/// <returns>Returns 1 if a solution was found, 0 if there is none, -1 if the solver gave up or on error.</returns>
+int SolveLevelParallel(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, int workerCount, LevelSolution *solution)
+{
+	ParallelSolver *parallel;
+	int result;
+	if ((parallel = CreateParallelSolver(workerCount, 1, solution)) == NULL)
+		return -1;
+	result = RunParallelSolver(parallel, def, endpoints, nodeLimit, 1);
+	//a level may only be solved by a path running next to itself, the search is repeated allowing it
+	if (result == 0 && parallel->solutions == 0)
+		result = RunParallelSolver(parallel, def, endpoints, nodeLimit, 0);
+	if (result == 0)
+		result = parallel->solutions > 0;
+	FreeParallelSolver(parallel);
+	return result;
+}
+
+/// <summary>
+/// Counts the solutions of a level that fill the whole board, paths running next to themselves included,
+/// on a pool of worker threads.
+/// </summary>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="nodeLimit">The number of branches every worker tries before giving up, 0 for no limit.</param>
+/// <param name="limit">The number of solutions to stop at, 0 to count them all.</param>
+/// <param name="workerCount">The number of threads.</param>
+/// <param name="count">Set to the number of solutions, at most the limit.</param>
+/// <param name="solution">The first solution found.</param>
+/// <returns>Returns -1 if the solver gave up or on error, 0 otherwise.</returns>
+int CountLevelSolutions(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, Uint32 limit, int workerCount,
+	Uint32 *count, LevelSolution *solution)
+{
+	ParallelSolver *parallel;
+	int result;
+	if ((parallel = CreateParallelSolver(workerCount, limit, solution)) == NULL)
+		return -1;
+	result = RunParallelSolver(parallel, def, endpoints, nodeLimit, 0);
+	//the workers finishing their tasks together may pass the limit
+	*count = limit != 0 && parallel->solutions > limit ? limit : parallel->solutions;
+	FreeParallelSolver(parallel);
+	return result;
+}
+
+/// <summary>
+/// Solves every level of a pack and reports the ones without a solution filling the board,
+/// or reports the number of solutions of every level.
+/// </summary>
+/// <param name="path">The path of a text or binary pack.</param>
+/// <param name="workerCount">The number of threads.</param>
+/// <param name="count">1 to count the solutions of every level, 0 to find one.</param>
+/// <returns>Returns -1 if the pack could not be read or a level could not be solved, 0 otherwise.</returns>
+int SolveLevels(const char *path, int workerCount, int count)
+{
+	LevelPack pack;
+	LevelSolution solution;
+	const LevelDef *def;
+	const Uint8 *endpoints;
+	Uint32 start, solutions;
+	int i, line, column, result, solved = 0;
+	if (OpenLevelPack(path, &pack) == -1 && OpenTextLevelPack(path, &pack, &line, &column) == -1)
+	{
+		printf("Unable to read %s\n", path);
+		return -1;
+	}
+	start = SDL_GetTicks();
+	for (i = 0; i < pack.count; i++)
+	{
+		if ((def = GetPlayableLevel(&pack, i, &endpoints)) == NULL)
+		{
+			printf("Level %d cannot be played\n", i + 1);
+			continue;
+		}
+		if (count)
+		{
+			if ((result = CountLevelSolutions(def, endpoints, SOLVER_NODE_LIMIT, 0, workerCount, &solutions, &solution)) == 0)
+			{
+				result = solutions > 0;
+				if (result)
+					printf("Level %d has %lu solutions\n", i + 1, (unsigned long)solutions);
+			}
+		}
+		else
+			result = SolveLevelParallel(def, endpoints, SOLVER_NODE_LIMIT, workerCount, &solution);
+		if (result == 1)
+			solved++;
+		else if (result == 0)
+			printf("Level %d has no solution\n", i + 1);
+		else
+			printf("Gave up on level %d\n", i + 1);
+	}
+	printf("Solved %d of %d levels on %d threads in %lu ms\n", solved, pack.count, workerCount,
+		(unsigned long)(SDL_GetTicks() - start));
+	result = solved == pack.count ? 0 : -1;
+	FreeLevelPack(&pack);
+	return result;
+}
@@ -0,0 +1,55 @@
+#ifndef PARALLELSOLVER_H
+#define PARALLELSOLVER_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "solver.h"
+
+#define PARALLELSOLVER_MAX_WORKERS 16
+#define PARALLELSOLVER_SPLIT_DEPTH 8 //the branches above this depth are split into tasks, the ones below are searched by a single worker
+//a deque holds the branches of the last task split and the branches left of the tasks above it, at most 4 per depth
+#define PARALLELSOLVER_DEQUE_SIZE (4 * PARALLELSOLVER_SPLIT_DEPTH + 4)
+
+typedef struct SolverTask
+{
+	SolverState state;
+	int depth; //the number of branches taken from the start of the level
+} SolverTask;
+
+//the tasks of a worker, it takes the newest ones itself and the other workers steal the oldest, which are the largest
+typedef struct SolverDeque
+{
+	SolverTask tasks[PARALLELSOLVER_DEQUE_SIZE]; //a ring from top to bottom
+	int top, bottom; //the oldest task and the one after the newest
+	SDL_mutex *lock; //guards top and bottom
+} SolverDeque;
+
+typedef struct SolverWorker
+{
+	struct ParallelSolver *parallel;
+	int index;
+	Solver solver; //a state stack of its own, its node limit counts the branches of this worker
+	SolverDeque deque;
+	LevelSolution solution; //the first solution of the task being run
+} SolverWorker;
+
+//a search of a level split into tasks run by a pool of worker threads
+typedef struct ParallelSolver
+{
+	SolverWorker workers[PARALLELSOLVER_MAX_WORKERS];
+	int workerCount;
+	int queued, pending; //the tasks in the deques, pending also counts the tasks being run
+	int result; //-1 once a worker gave up
+	Uint32 solutions, solutionLimit; //the search is cancelled once it found solutionLimit solutions, 0 counts them all
+	LevelSolution *solution; //the first solution found
+	AtomicInt cancelled; //the workers stop as soon as they see it
+	SDL_mutex *lock; //guards queued, pending, result, solutions and solution
+	SDL_cond *changed; //signalled when a task is queued, the last task is done or the search is cancelled
+} ParallelSolver;
+
+int SolveLevelParallel(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, int workerCount, LevelSolution *solution);
+int CountLevelSolutions(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, Uint32 limit, int workerCount,
+	Uint32 *count, LevelSolution *solution);
+int SolveLevels(const char *path, int workerCount, int count);
+
+#endif
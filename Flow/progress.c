@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "progress.h"
+#include "autosave.h"
+
+typedef char ProgressRecordSizeCheck[sizeof(ProgressRecord) == 12 ? 1 : -1];
+
+/// <summary>
+/// Computes the check byte of a record from its other bytes.
+/// </summary>
+/// <param name="record">The record.</param>
+/// <returns>Returns the check byte.</returns>
+Uint8 ProgressRecordCheck(const ProgressRecord *record)
+{
+	const Uint8 *bytes = (const Uint8 *)record;
+	Uint8 check = 0x5a;
+	int i;
+	for (i = 0; i < (int)sizeof(ProgressRecord); i++)
+	{
+		if (bytes + i != &record->check)
+			check = (Uint8)(((check << 1) | (check >> 7)) ^ bytes[i]);
+	}
+	return check;
+}
+
+/// <summary>
+/// Reads the next record of a journal.
+/// </summary>
+/// <param name="file">The journal.</param>
+/// <param name="record">The record read.</param>
+/// <param name="levelCount">The number of levels of the pack.</param>
+/// <returns>Returns -1 at the end of the journal or on a torn record, 0 otherwise.</returns>
+int ReadProgressRecord(FILE *file, ProgressRecord *record, int levelCount)
+{
+	if (fread(record, sizeof(ProgressRecord), 1, file) != 1 || record->check != ProgressRecordCheck(record) ||
+		record->level >= (Uint32)levelCount || record->state > Starred)
+		return -1;
+	return 0;
+}
+
+/// <summary>
+/// Replays a progress journal into a pack and opens it for appending. A missing or torn
+/// journal is rewritten first, a journal with too many superseded records is compacted in the background.
+/// </summary>
+/// <param name="journal">The journal.</param>
+/// <param name="path">The path of the journal.</param>
+/// <param name="pack">The level pack the journal belongs to.</param>
+/// <returns>Returns -1 if changes cannot be journaled, 0 otherwise.</returns>
+int OpenProgressJournal(ProgressJournal *journal, const char *path, LevelPack *pack)
+{
+	ProgressHeader header;
+	ProgressRecord record;
+	FILE *file;
+	Uint8 *seen;
+	Uint32 levels = 0;
+	int whole = 0;
+	memset(journal, 0, sizeof(ProgressJournal));
+	journal->path = path;
+	journal->levelCount = pack->count;
+	if ((journal->lock = SDL_CreateMutex()) == NULL)
+		return -1;
+	if ((seen = (Uint8 *)calloc(pack->count / 8 + 1, 1)) == NULL)
+		return -1;
+	//later records override earlier ones, a crash can only have torn the last record
+	if ((file = fopen(path, "rb")) != NULL)
+	{
+		if (fread(&header, sizeof(ProgressHeader), 1, file) == 1 &&
+			memcmp(header.magic, PROGRESS_MAGIC, 4) == 0 && header.version == PROGRESS_VERSION)
+		{
+			while (ReadProgressRecord(file, &record, pack->count) == 0)
+			{
+				SetLevelProgress(pack, record.level, (LevelState)record.state, record.timeRecord);
+				if ((seen[record.level >> 3] & (1 << (record.level & 7))) == 0)
+				{
+					seen[record.level >> 3] |= 1 << (record.level & 7);
+					levels++;
+				}
+				journal->recordCount++;
+			}
+			whole = ftell(file) == (long)(sizeof(ProgressHeader) + journal->recordCount * sizeof(ProgressRecord));
+		}
+		fclose(file);
+	}
+	free(seen);
+	if (!whole) //nothing can be appended after a torn record
+		return CompactProgressJournal(journal);
+	if ((journal->file = fopen(path, "ab")) == NULL)
+		return -1;
+	if (journal->recordCount > levels * 2 + PROGRESS_COMPACT_SLACK)
+		journal->compaction = SDL_CreateThread(CompactProgressJournal, journal);
+	return 0;
+}
+
+/// <summary>
+/// Appends a change of a level to the journal.
+/// </summary>
+/// <param name="journal">The journal.</param>
+/// <param name="level">The index of the level.</param>
+/// <param name="state">The new state.</param>
+/// <param name="timeRecord">The new best time.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int AppendProgress(ProgressJournal *journal, int level, LevelState state, Uint32 timeRecord)
+{
+	ProgressRecord record;
+	int result = 0;
+	if (journal->lock == NULL)
+		return -1;
+	memset(&record, 0, sizeof(ProgressRecord));
+	record.level = level;
+	record.state = state;
+	record.timeRecord = timeRecord;
+	record.check = ProgressRecordCheck(&record);
+	SDL_LockMutex(journal->lock);
+	//synced right away, a crash loses at most the record being written
+	if (journal->file == NULL)
+		result = -1;
+	else if (fwrite(&record, sizeof(ProgressRecord), 1, journal->file) != 1 || SyncFile(journal->file) == -1)
+	{
+		fclose(journal->file); //a torn record would hide the records after it
+		journal->file = NULL;
+		result = -1;
+	}
+	else
+		journal->recordCount++;
+	SDL_UnlockMutex(journal->lock);
+	return result;
+}
+
+/// <summary>
+/// Rewrites the journal with only the last record of every level. Records appended while
+/// it runs are carried over, so it can run on its own thread.
+/// </summary>
+/// <param name="data">The journal.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int CompactProgressJournal(void *data)
+{
+	ProgressJournal *journal = (ProgressJournal *)data;
+	char temp[FILENAME_MAX];
+	ProgressHeader header;
+	ProgressRecord *records, record;
+	Uint8 *seen;
+	FILE *file, *compacted;
+	Uint32 known, count = 0, kept = 0, i;
+	int result = -1;
+	if (strlen(journal->path) + 5 > sizeof(temp))
+		return -1;
+	sprintf(temp, "%s.tmp", journal->path);
+	SDL_LockMutex(journal->lock);
+	known = journal->recordCount;
+	SDL_UnlockMutex(journal->lock);
+	if ((compacted = fopen(temp, "wb")) == NULL)
+		return -1;
+	//the records known so far are compacted without holding the lock
+	records = (ProgressRecord *)malloc(known * sizeof(ProgressRecord) + 1);
+	seen = (Uint8 *)calloc(journal->levelCount / 8 + 1, 1);
+	if (records != NULL && seen != NULL)
+	{
+		if ((file = fopen(journal->path, "rb")) != NULL)
+		{
+			if (fseek(file, sizeof(ProgressHeader), SEEK_SET) == 0)
+				while (count < known && ReadProgressRecord(file, &records[count], journal->levelCount) == 0)
+					count++;
+			fclose(file);
+		}
+		//walk backwards so the last record of a level is the one kept
+		kept = count;
+		for (i = count; i-- > 0;)
+		{
+			if ((seen[records[i].level >> 3] & (1 << (records[i].level & 7))) == 0)
+			{
+				seen[records[i].level >> 3] |= 1 << (records[i].level & 7);
+				records[--kept] = records[i];
+			}
+		}
+		memcpy(header.magic, PROGRESS_MAGIC, 4);
+		header.version = PROGRESS_VERSION;
+		if (fwrite(&header, sizeof(ProgressHeader), 1, compacted) == 1 &&
+			fwrite(&records[kept], sizeof(ProgressRecord), count - kept, compacted) == count - kept)
+			result = 0;
+		kept = count - kept;
+	}
+	free(records);
+	free(seen);
+	SDL_LockMutex(journal->lock);
+	//records appended meanwhile are copied before the journal is replaced
+	if (result == 0 && journal->recordCount > known)
+	{
+		if ((file = fopen(journal->path, "rb")) == NULL ||
+			fseek(file, (long)(sizeof(ProgressHeader) + known * sizeof(ProgressRecord)), SEEK_SET) != 0)
+			result = -1;
+		for (i = known; result == 0 && i < journal->recordCount; i++)
+		{
+			if (fread(&record, sizeof(ProgressRecord), 1, file) != 1 ||
+				fwrite(&record, sizeof(ProgressRecord), 1, compacted) != 1)
+				result = -1;
+		}
+		if (file != NULL)
+			fclose(file);
+	}
+	if (SyncFile(compacted) == -1)
+		result = -1;
+	if (fclose(compacted) != 0)
+		result = -1;
+	if (result == 0)
+	{
+		if (journal->file != NULL)
+			fclose(journal->file); //the journal cannot be replaced while it is open
+		if (ReplaceWithFile(temp, journal->path) == 0)
+			journal->recordCount = kept + journal->recordCount - known;
+		else
+			result = -1;
+		journal->file = fopen(journal->path, "ab");
+	}
+	if (result == -1)
+		remove(temp);
+	SDL_UnlockMutex(journal->lock);
+	return result;
+}
+
+/// <summary>
+/// Waits for the compaction and closes the journal.
+/// </summary>
+/// <param name="journal">The journal.</param>
+void CloseProgressJournal(ProgressJournal *journal)
+{
+	if (journal->compaction != NULL)
+		SDL_WaitThread(journal->compaction, NULL);
+	if (journal->file != NULL)
+		fclose(journal->file);
+	if (journal->lock != NULL)
+		SDL_DestroyMutex(journal->lock);
+	memset(journal, 0, sizeof(ProgressJournal));
+}
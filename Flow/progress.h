@@ -0,0 +1,42 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdio.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "levelpack.h"
+
+#define PROGRESS_MAGIC "FLWJ"
+#define PROGRESS_VERSION 1
+#define PROGRESS_COMPACT_SLACK 256 //superseded records tolerated before compacting
+
+//journal layout: the header, then one record per change, stored little-endian
+typedef struct ProgressHeader
+{
+	char magic[4];
+	Uint32 version;
+} ProgressHeader;
+
+typedef struct ProgressRecord
+{
+	Uint32 level;
+	Uint8 state, check, reserved[2]; //check tells a torn record from a written one
+	Uint32 timeRecord;
+} ProgressRecord;
+
+typedef struct ProgressJournal
+{
+	FILE *file; //opened for appending, NULL if the journal cannot be written
+	const char *path;
+	int levelCount; //the levels of the pack the records belong to
+	Uint32 recordCount; //the records in the file
+	SDL_mutex *lock; //guards file and recordCount against the compaction thread
+	SDL_Thread *compaction;
+} ProgressJournal;
+
+int OpenProgressJournal(ProgressJournal *journal, const char *path, LevelPack *pack);
+int AppendProgress(ProgressJournal *journal, int level, LevelState state, Uint32 timeRecord);
+int CompactProgressJournal(void *data);
+void CloseProgressJournal(ProgressJournal *journal);
+
+#endif
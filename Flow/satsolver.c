@@ -0,0 +1,614 @@
+#include <stdlib.h>
+#include <string.h>
+#include "satsolver.h"
+
+/// <summary>
+/// Gets the value of a literal.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="literal">The literal.</param>
+/// <returns>Returns 1 if the literal is true, 0 if it is false, SAT_UNASSIGNED otherwise.</returns>
+int GetSatLiteralValue(const SatSolver *sat, int literal)
+{
+	int value = sat->values[literal >> 1];
+	return value == SAT_UNASSIGNED ? SAT_UNASSIGNED : value ^ (literal & 1);
+}
+
+/// <summary>
+/// Moves a variable of the heap up to its place.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="i">The index of the variable in the heap.</param>
+void SiftSatHeapUp(SatSolver *sat, int i)
+{
+	int variable = sat->heap[i], parent;
+	while (i > 0 && sat->activities[sat->heap[parent = (i - 1) / 2]] < sat->activities[variable])
+	{
+		sat->heap[i] = sat->heap[parent];
+		sat->heapIndices[sat->heap[i]] = i;
+		i = parent;
+	}
+	sat->heap[i] = variable;
+	sat->heapIndices[variable] = i;
+}
+
+/// <summary>
+/// Moves a variable of the heap down to its place.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="i">The index of the variable in the heap.</param>
+void SiftSatHeapDown(SatSolver *sat, int i)
+{
+	int variable = sat->heap[i], child;
+	while ((child = i * 2 + 1) < sat->heapCount)
+	{
+		if (child + 1 < sat->heapCount && sat->activities[sat->heap[child + 1]] > sat->activities[sat->heap[child]])
+			child++;
+		if (sat->activities[sat->heap[child]] <= sat->activities[variable])
+			break;
+		sat->heap[i] = sat->heap[child];
+		sat->heapIndices[sat->heap[i]] = i;
+		i = child;
+	}
+	sat->heap[i] = variable;
+	sat->heapIndices[variable] = i;
+}
+
+/// <summary>
+/// Makes a variable a choice again, once it is unassigned.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="variable">The variable.</param>
+void InsertSatVariable(SatSolver *sat, int variable)
+{
+	if (sat->heapIndices[variable] != -1)
+		return;
+	sat->heap[sat->heapCount] = variable;
+	SiftSatHeapUp(sat, sat->heapCount++);
+}
+
+/// <summary>
+/// Takes the most active variable from the heap.
+/// </summary>
+/// <param name="sat">The solver, with variables in the heap.</param>
+/// <returns>Returns the variable.</returns>
+int RemoveSatMaximum(SatSolver *sat)
+{
+	int variable = sat->heap[0];
+	sat->heapIndices[variable] = -1;
+	if (--sat->heapCount > 0)
+	{
+		sat->heap[0] = sat->heap[sat->heapCount];
+		SiftSatHeapDown(sat, 0);
+	}
+	return variable;
+}
+
+/// <summary>
+/// Makes a variable of a conflict more likely to be chosen.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="variable">The variable.</param>
+void BumpSatActivity(SatSolver *sat, int variable)
+{
+	int i;
+	if ((sat->activities[variable] += sat->activityIncrement) > 1e100)
+	{
+		//the activities are scaled down together, which keeps their order
+		for (i = 0; i < sat->variableCount; i++)
+			sat->activities[i] *= 1e-100;
+		sat->activityIncrement *= 1e-100;
+	}
+	if (sat->heapIndices[variable] != -1)
+		SiftSatHeapUp(sat, sat->heapIndices[variable]);
+}
+
+/// <summary>
+/// Adds a clause to the clauses watching a literal.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="literal">The literal.</param>
+/// <param name="clause">The clause.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int AddSatWatch(SatSolver *sat, int literal, int clause)
+{
+	int *watches, capacity;
+	if (sat->watchCounts[literal] == sat->watchCapacities[literal])
+	{
+		capacity = sat->watchCapacities[literal] == 0 ? 4 : sat->watchCapacities[literal] * 2;
+		if ((watches = (int *)realloc(sat->watches[literal], capacity * sizeof(int))) == NULL)
+			return -1;
+		sat->watches[literal] = watches;
+		sat->watchCapacities[literal] = capacity;
+	}
+	sat->watches[literal][sat->watchCounts[literal]++] = clause;
+	return 0;
+}
+
+/// <summary>
+/// Stores a clause of two or more literals and watches its first two.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="literals">The literals.</param>
+/// <param name="count">The number of literals.</param>
+/// <param name="levels">The number of levels of the literals of a learnt clause, 0 for a clause that was added.</param>
+/// <returns>Returns the clause, -1 on error.</returns>
+int StoreSatClause(SatSolver *sat, const int *literals, int count, int levels)
+{
+	Sint32 *clauses;
+	int capacity, clause = sat->clauseUsed, i;
+	if (sat->clauseUsed + count + 2 > sat->clauseCapacity)
+	{
+		for (capacity = sat->clauseCapacity == 0 ? 1024 : sat->clauseCapacity; capacity < sat->clauseUsed + count + 2;)
+			capacity *= 2;
+		if ((clauses = (Sint32 *)realloc(sat->clauses, capacity * sizeof(Sint32))) == NULL)
+			return -1;
+		sat->clauses = clauses;
+		sat->clauseCapacity = capacity;
+	}
+	sat->clauses[sat->clauseUsed++] = count;
+	sat->clauses[sat->clauseUsed++] = levels;
+	if (levels != 0)
+		sat->learntCount++;
+	for (i = 0; i < count; i++)
+		sat->clauses[sat->clauseUsed++] = literals[i];
+	if (AddSatWatch(sat, literals[0], clause) == -1 || AddSatWatch(sat, literals[1], clause) == -1)
+		return -1;
+	return clause;
+}
+
+/// <summary>
+/// Makes a literal true.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="literal">The literal, unassigned.</param>
+/// <param name="reason">The clause that implies it, its first literal, -1 for a choice.</param>
+void AssignSat(SatSolver *sat, int literal, int reason)
+{
+	sat->values[literal >> 1] = (Uint8)((literal & 1) ^ 1);
+	sat->levels[literal >> 1] = sat->level;
+	sat->reasons[literal >> 1] = reason;
+	sat->trail[sat->trailCount++] = literal;
+}
+
+/// <summary>
+/// Undoes the assignments of the decision levels above a level.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="level">The level to go back to.</param>
+void BacktrackSat(SatSolver *sat, int level)
+{
+	int i, variable;
+	if (sat->level <= level)
+		return;
+	for (i = sat->trailCount - 1; i >= sat->levelStarts[level + 1]; i--)
+	{
+		variable = sat->trail[i] >> 1;
+		sat->phases[variable] = sat->values[variable];
+		sat->values[variable] = SAT_UNASSIGNED;
+		InsertSatVariable(sat, variable);
+	}
+	sat->trailCount = sat->propagated = sat->levelStarts[level + 1];
+	sat->level = level;
+}
+
+/// <summary>
+/// Assigns the literals implied by the clauses until none is left or a clause is false.
+/// Only the clauses watching a literal made false are visited.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <returns>Returns the false clause, -1 if there is none.</returns>
+int PropagateSat(SatSolver *sat)
+{
+	Sint32 *clause;
+	int *watches, literal, i, j, k, count, reference, size;
+	while (sat->propagated < sat->trailCount)
+	{
+		literal = sat->trail[sat->propagated++] ^ 1;
+		watches = sat->watches[literal];
+		count = sat->watchCounts[literal];
+		for (i = j = 0; i < count; i++)
+		{
+			reference = watches[i];
+			size = sat->clauses[reference];
+			clause = &sat->clauses[reference + 2];
+			//the false literal is kept second, the first one is implied if no other literal can be watched
+			if (clause[0] == literal)
+			{
+				clause[0] = clause[1];
+				clause[1] = literal;
+			}
+			if (GetSatLiteralValue(sat, clause[0]) == 1)
+			{
+				watches[j++] = reference;
+				continue;
+			}
+			for (k = 2; k < size && GetSatLiteralValue(sat, clause[k]) == 0; k++);
+			if (k < size)
+			{
+				clause[1] = clause[k];
+				clause[k] = literal;
+				if (AddSatWatch(sat, clause[1], reference) == 0)
+					continue;
+				//out of memory, the clause goes on watching the false literal and the search stops
+				clause[k] = clause[1];
+				clause[1] = literal;
+				sat->failed = 1;
+			}
+			watches[j++] = reference;
+			if (GetSatLiteralValue(sat, clause[0]) == 0)
+			{
+				while (++i < count)
+					watches[j++] = watches[i];
+				sat->watchCounts[literal] = j;
+				return reference;
+			}
+			AssignSat(sat, clause[0], reference);
+		}
+		sat->watchCounts[literal] = j;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Determines whether a literal of a learnt clause follows from the other literals, as the literals
+/// of the clause that implied it are all in the learnt clause or fixed.
+/// </summary>
+/// <param name="sat">The solver, the variables of the learnt clause are seen.</param>
+/// <param name="literal">The literal.</param>
+/// <returns>Returns 1 if the literal can be left out, 0 otherwise.</returns>
+int IsSatLiteralRedundant(const SatSolver *sat, int literal)
+{
+	const Sint32 *clause;
+	int i, size;
+	if (sat->reasons[literal >> 1] == -1)
+		return 0;
+	size = sat->clauses[sat->reasons[literal >> 1]];
+	clause = &sat->clauses[sat->reasons[literal >> 1] + 2];
+	for (i = 1; i < size; i++)
+		if (!sat->seen[clause[i] >> 1] && sat->levels[clause[i] >> 1] != 0)
+			return 0;
+	return 1;
+}
+
+/// <summary>
+/// Learns a clause from a conflict: the literals of the conflict are replaced by the literals that
+/// implied them until a single one of the last decision level is left, the first unique implication point.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="conflict">The false clause.</param>
+/// <param name="backLevel">Set to the level to go back to, where the clause implies its first literal.</param>
+/// <returns>Returns the number of literals of the clause, which is left in the learnt literals.</returns>
+int AnalyzeSatConflict(SatSolver *sat, int conflict, int *backLevel)
+{
+	const Sint32 *clause;
+	int count = 1, pending = 0, literal = -1, index = sat->trailCount - 1, i, j, variable, size;
+	do
+	{
+		//the first literal of a clause that implied a literal is that literal
+		size = sat->clauses[conflict];
+		clause = &sat->clauses[conflict + 2];
+		for (i = literal == -1 ? 0 : 1; i < size; i++)
+		{
+			variable = clause[i] >> 1;
+			if (sat->seen[variable] || sat->levels[variable] == 0)
+				continue;
+			BumpSatActivity(sat, variable);
+			sat->seen[variable] = 1;
+			if (sat->levels[variable] == sat->level)
+				pending++;
+			else
+				sat->learnt[count++] = clause[i];
+		}
+		while (!sat->seen[sat->trail[index] >> 1])
+			index--;
+		literal = sat->trail[index--];
+		conflict = sat->reasons[literal >> 1];
+		sat->seen[literal >> 1] = 0;
+	} while (--pending > 0);
+	sat->learnt[0] = literal ^ 1;
+	for (i = 1; i < count; i++)
+		if (IsSatLiteralRedundant(sat, sat->learnt[i]))
+			sat->seen[sat->learnt[i] >> 1] = 2;
+	for (i = j = 1; i < count; i++)
+	{
+		if (sat->seen[sat->learnt[i] >> 1] == 1)
+			sat->learnt[j++] = sat->learnt[i];
+		sat->seen[sat->learnt[i] >> 1] = 0;
+	}
+	count = j;
+	//the literal of the highest level is watched, it is the last one to be unassigned
+	*backLevel = 0;
+	for (i = j = 1; i < count; i++)
+	{
+		if (sat->levels[sat->learnt[i] >> 1] > *backLevel)
+		{
+			*backLevel = sat->levels[sat->learnt[i] >> 1];
+			j = i;
+		}
+	}
+	literal = sat->learnt[1];
+	sat->learnt[1] = sat->learnt[j];
+	sat->learnt[j] = literal;
+	return count;
+}
+
+/// <summary>
+/// Counts the decision levels of the literals of a learnt clause, before going back. A clause
+/// of few levels is likely to imply literals again.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="count">The number of learnt literals.</param>
+/// <returns>Returns the number of levels.</returns>
+int CountSatLevels(SatSolver *sat, int count)
+{
+	int levels = 0, level, i;
+	for (i = 0; i < count; i++)
+	{
+		level = sat->levels[sat->learnt[i] >> 1];
+		if (sat->levelMarks[level] != sat->conflicts)
+		{
+			sat->levelMarks[level] = sat->conflicts;
+			levels++;
+		}
+	}
+	return levels;
+}
+
+/// <summary>
+/// Drops the learnt clauses of the most levels, about half of them, at decision level 0.
+/// The clauses left are moved together and watched again.
+/// </summary>
+/// <param name="sat">The solver, at level 0.</param>
+void ReduceSatClauses(SatSolver *sat)
+{
+	int counts[SAT_LEVEL_COUNTS], limit, kept, spare, from, to, size, levels, i;
+	memset(counts, 0, sizeof(counts));
+	for (from = 0; from < sat->clauseUsed; from += sat->clauses[from] + 2)
+		if ((levels = sat->clauses[from + 1]) != 0)
+			counts[levels < SAT_LEVEL_COUNTS ? levels : SAT_LEVEL_COUNTS - 1]++;
+	//the clauses below the limit are kept and as many of the limit as needed to keep half of them
+	for (limit = 1, kept = 0; limit < SAT_LEVEL_COUNTS - 1 && kept + counts[limit] < sat->learntCount / 2; limit++)
+		kept += counts[limit];
+	spare = sat->learntCount / 2 - kept;
+	sat->learntCount = 0;
+	for (from = to = 0; from < sat->clauseUsed; from += size + 2)
+	{
+		size = sat->clauses[from];
+		if ((levels = sat->clauses[from + 1]) != 0)
+		{
+			if (levels >= SAT_LEVEL_COUNTS)
+				levels = SAT_LEVEL_COUNTS - 1;
+			if (levels > 2 && (levels > limit || (levels == limit && spare-- <= 0)))
+				continue;
+			sat->learntCount++;
+		}
+		memmove(&sat->clauses[to], &sat->clauses[from], (size + 2) * sizeof(Sint32));
+		to += size + 2;
+	}
+	sat->clauseUsed = to;
+	//the watches only get fewer, they fit
+	for (i = 0; i < sat->variableCount * 2; i++)
+		sat->watchCounts[i] = 0;
+	for (from = 0; from < sat->clauseUsed; from += sat->clauses[from] + 2)
+	{
+		AddSatWatch(sat, sat->clauses[from + 2], from);
+		AddSatWatch(sat, sat->clauses[from + 3], from);
+	}
+	for (i = 0; i < sat->trailCount; i++)
+		sat->reasons[sat->trail[i] >> 1] = -1;
+}
+
+/// <summary>
+/// Gets a number of the Luby sequence, 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8...
+/// </summary>
+/// <param name="index">The index of the number.</param>
+/// <returns>Returns the number.</returns>
+Uint32 GetLubyNumber(Uint32 index)
+{
+	Uint32 size = 1, power = 0;
+	while (size < index + 1)
+	{
+		power++;
+		size = size * 2 + 1;
+	}
+	while (size - 1 != index)
+	{
+		size = (size - 1) / 2;
+		power--;
+		index %= size;
+	}
+	return (Uint32)1 << power;
+}
+
+/// <summary>
+/// Prepares a solver without clauses.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="variableCount">The number of variables.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int InitSatSolver(SatSolver *sat, int variableCount)
+{
+	int i;
+	memset(sat, 0, sizeof(SatSolver));
+	sat->variableCount = variableCount;
+	sat->activityIncrement = 1;
+	if ((sat->watches = (int **)calloc(variableCount * 2 + 1, sizeof(int *))) == NULL ||
+		(sat->watchCounts = (int *)calloc(variableCount * 2 + 1, sizeof(int))) == NULL ||
+		(sat->watchCapacities = (int *)calloc(variableCount * 2 + 1, sizeof(int))) == NULL ||
+		(sat->values = (Uint8 *)malloc(variableCount + 1)) == NULL ||
+		(sat->phases = (Uint8 *)calloc(variableCount + 1, 1)) == NULL ||
+		(sat->seen = (Uint8 *)calloc(variableCount + 1, 1)) == NULL ||
+		(sat->levels = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->reasons = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->trail = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->levelStarts = (int *)calloc(variableCount + 2, sizeof(int))) == NULL ||
+		(sat->activities = (double *)calloc(variableCount + 1, sizeof(double))) == NULL ||
+		(sat->heap = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->heapIndices = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->learnt = (int *)malloc((variableCount + 1) * sizeof(int))) == NULL ||
+		(sat->levelMarks = (Uint32 *)calloc(variableCount + 2, sizeof(Uint32))) == NULL)
+	{
+		FreeSatSolver(sat);
+		return -1;
+	}
+	memset(sat->values, SAT_UNASSIGNED, variableCount + 1);
+	for (i = 0; i < variableCount; i++)
+		sat->heap[i] = sat->heapIndices[i] = i;
+	sat->heapCount = variableCount;
+	sat->learntLimit = SAT_LEARNT_LIMIT;
+	return 0;
+}
+
+/// <summary>
+/// Adds a clause, between searches. A clause made false by the literals fixed so far makes the
+/// clauses unsatisfiable and one with a single literal left fixes it.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="literals">The literals, in any order.</param>
+/// <param name="count">The number of literals.</param>
+/// <returns>Returns -1 on error, 0 otherwise.</returns>
+int AddSatClause(SatSolver *sat, const int *literals, int count)
+{
+	int i, j, kept = 0, value;
+	if (sat->unsatisfiable)
+		return 0;
+	BacktrackSat(sat, 0);
+	for (i = 0; i < count; i++)
+	{
+		if ((value = GetSatLiteralValue(sat, literals[i])) == 1)
+			return 0;
+		if (value == 0)
+			continue;
+		for (j = 0; j < kept && sat->learnt[j] != literals[i]; j++)
+			if (sat->learnt[j] == (literals[i] ^ 1))
+				return 0;
+		if (j == kept)
+			sat->learnt[kept++] = literals[i];
+	}
+	if (kept == 0)
+		sat->unsatisfiable = 1;
+	else if (kept == 1)
+	{
+		AssignSat(sat, sat->learnt[0], -1);
+		if (PropagateSat(sat) != -1)
+			sat->unsatisfiable = 1;
+	}
+	else if (StoreSatClause(sat, sat->learnt, kept, 0) == -1)
+		return -1;
+	return sat->failed ? -1 : 0;
+}
+
+/// <summary>
+/// Searches for values of the variables satisfying every clause. The search starts over
+/// now and then, keeping what it learnt, and can be run again after clauses are added.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="conflictLimit">The number of conflicts of the solver, searches before included,
+/// before giving up, 0 for no limit.</param>
+/// <returns>Returns 1 if the clauses are satisfied, the values are kept until a clause is added,
+/// 0 if they cannot be, -1 if the solver gave up or on error.</returns>
+int SolveSat(SatSolver *sat, Uint32 conflictLimit)
+{
+	Uint32 restarts = 0, runConflicts = 0;
+	int conflict, count, backLevel, clause, variable, levels;
+	if (sat->unsatisfiable)
+		return 0;
+	BacktrackSat(sat, 0);
+	while (1)
+	{
+		conflict = PropagateSat(sat);
+		if (sat->failed)
+			return -1;
+		if (conflict != -1)
+		{
+			sat->conflicts++;
+			runConflicts++;
+			if (sat->level == 0)
+			{
+				sat->unsatisfiable = 1;
+				return 0;
+			}
+			count = AnalyzeSatConflict(sat, conflict, &backLevel);
+			levels = CountSatLevels(sat, count);
+			BacktrackSat(sat, backLevel);
+			if (count == 1)
+				AssignSat(sat, sat->learnt[0], -1);
+			else
+			{
+				if ((clause = StoreSatClause(sat, sat->learnt, count, levels)) == -1)
+				{
+					sat->failed = 1;
+					return -1;
+				}
+				AssignSat(sat, sat->learnt[0], clause);
+			}
+			sat->activityIncrement /= SAT_ACTIVITY_DECAY;
+			continue;
+		}
+		if (conflictLimit != 0 && sat->conflicts >= conflictLimit)
+			return -1;
+		if (runConflicts >= GetLubyNumber(restarts) * SAT_RESTART_UNIT)
+		{
+			BacktrackSat(sat, 0);
+			restarts++;
+			runConflicts = 0;
+			continue;
+		}
+		if (sat->learntCount >= sat->learntLimit)
+		{
+			BacktrackSat(sat, 0);
+			ReduceSatClauses(sat);
+			sat->learntLimit += sat->learntLimit / 10;
+			continue;
+		}
+		variable = -1;
+		while (variable == -1 && sat->heapCount > 0)
+			if (sat->values[variable = RemoveSatMaximum(sat)] != SAT_UNASSIGNED)
+				variable = -1;
+		if (variable == -1)
+			return 1;
+		sat->levelStarts[++sat->level] = sat->trailCount;
+		AssignSat(sat, SAT_LITERAL(variable, !sat->phases[variable]), -1);
+	}
+}
+
+/// <summary>
+/// Gets the value of a variable after a search satisfied the clauses.
+/// </summary>
+/// <param name="sat">The solver.</param>
+/// <param name="variable">The variable.</param>
+/// <returns>Returns 1 if the variable is true, 0 otherwise.</returns>
+int GetSatValue(const SatSolver *sat, int variable)
+{
+	return sat->values[variable] == 1;
+}
+
+/// <summary>
+/// Frees the solver.
+/// </summary>
+/// <param name="sat">The solver.</param>
+void FreeSatSolver(SatSolver *sat)
+{
+	int i;
+	if (sat->watches != NULL)
+		for (i = 0; i < sat->variableCount * 2; i++)
+			free(sat->watches[i]);
+	free(sat->watches);
+	free(sat->watchCounts);
+	free(sat->watchCapacities);
+	free(sat->values);
+	free(sat->phases);
+	free(sat->seen);
+	free(sat->levels);
+	free(sat->reasons);
+	free(sat->trail);
+	free(sat->levelStarts);
+	free(sat->activities);
+	free(sat->heap);
+	free(sat->heapIndices);
+	free(sat->learnt);
+	free(sat->levelMarks);
+	free(sat->clauses);
+	memset(sat, 0, sizeof(SatSolver));
+}
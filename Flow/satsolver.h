@@ -0,0 +1,47 @@
+#ifndef SATSOLVER_H
+#define SATSOLVER_H
+
+#include <SDL.h>
+
+//a literal is a variable, or its negation for an odd literal
+#define SAT_LITERAL(variable, negated) ((variable) * 2 + ((negated) ? 1 : 0))
+#define SAT_UNASSIGNED 2 //the value of a variable without one
+#define SAT_RESTART_UNIT 100 //the conflicts of the shortest run between restarts, the runs follow the Luby sequence
+#define SAT_ACTIVITY_DECAY 0.95 //how fast the variables of old conflicts stop being chosen first
+#define SAT_LEARNT_LIMIT 2000 //the learnt clauses kept before the worse half is dropped, the limit grows by a tenth each time
+#define SAT_LEVEL_COUNTS 32 //the numbers of levels of learnt clauses told apart when dropping them
+
+//a CDCL solver: two watched literals per clause, first UIP learning, VSIDS choices and phase saving
+typedef struct SatSolver
+{
+	int variableCount;
+	Sint32 *clauses; //the size, the number of levels of a learnt clause or 0 and the literals of every clause,
+	//the first two literals are watched
+	int clauseUsed, clauseCapacity;
+	int learntCount, learntLimit;
+	int **watches; //the clauses watching every literal
+	int *watchCounts, *watchCapacities;
+	Uint8 *values; //0, 1 or SAT_UNASSIGNED for every variable
+	Uint8 *phases; //the last value of every variable, used when it is chosen
+	Uint8 *seen; //scratch of the conflict analysis
+	int *levels, *reasons; //the decision level of every assigned variable and the clause that implied it, -1 for a choice
+	int *trail; //the assigned literals in order
+	int trailCount, propagated; //propagated is the number of trail literals whose clauses were visited
+	int *levelStarts; //the trail index of the first literal of every decision level
+	int level;
+	double *activities, activityIncrement;
+	int *heap, *heapIndices, heapCount; //the unassigned variables by activity, -1 for a variable out of the heap
+	int *learnt; //scratch of the conflict analysis
+	Uint32 *levelMarks; //the last conflict that counted the levels of its learnt clause, for every level
+	Uint32 conflicts;
+	int unsatisfiable; //1 once the clauses added cannot be satisfied
+	int failed; //1 once memory ran out, the solver cannot go on
+} SatSolver;
+
+int InitSatSolver(SatSolver *sat, int variableCount);
+int AddSatClause(SatSolver *sat, const int *literals, int count);
+int SolveSat(SatSolver *sat, Uint32 conflictLimit);
+int GetSatValue(const SatSolver *sat, int variable);
+void FreeSatSolver(SatSolver *sat);
+
+#endif
@@ -0,0 +1,219 @@
+#ifdef FLOW_TESTS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "autosave.h"
+#include "levelpack.h"
+#include "selftests.h"
+
+/// <summary>
+/// Posts new high scores to an autosave every millisecond until the process is killed,
+/// the scores are n, n + 1 and n + 2 for growing n. TestAutosaveKill runs it in another process.
+/// </summary>
+/// <param name="path">The path of the scores.</param>
+/// <returns>Returns -1 if the autosave thread could not be started, it does not return otherwise.</returns>
+int RunAutosaveWriter(const char *path)
+{
+	Autosave autosave;
+	int scores[3], n;
+	if (StartAutosave(&autosave, NULL, path) == -1)
+		return -1;
+	for (n = 0; ; n++)
+	{
+		scores[0] = n;
+		scores[1] = n + 1;
+		scores[2] = n + 2;
+		PostScores(&autosave, scores);
+		SDL_Delay(1);
+	}
+}
+
+/// <summary>
+/// Reads the scores written by RunAutosaveWriter.
+/// </summary>
+/// <param name="path">The path of the scores.</param>
+/// <param name="first">The first score.</param>
+/// <returns>Returns -1 if the file is missing or torn, 0 otherwise.</returns>
+int ReadAutosaveScores(const char *path, int *first)
+{
+	FILE *file;
+	char text[64];
+	size_t length;
+	int scores[3], read = 0;
+	if ((file = fopen(path, "rb")) == NULL)
+		return -1;
+	length = fread(text, 1, sizeof(text) - 1, file);
+	fclose(file);
+	text[length] = '\0';
+	if (sscanf(text, "%d,%d,%d%n", &scores[0], &scores[1], &scores[2], &read) != 3 || read != (int)length ||
+		scores[1] != scores[0] + 1 || scores[2] != scores[0] + 2)
+		return -1;
+	*first = scores[0];
+	return 0;
+}
+
+/// <summary>
+/// Starts RunAutosaveWriter in another process and kills it after a while.
+/// </summary>
+/// <param name="program">The path of this program.</param>
+/// <param name="path">The path of the scores.</param>
+/// <param name="delay">The milliseconds before the writer is killed.</param>
+/// <returns>Returns -1 if the writer could not be started, 0 otherwise.</returns>
+int KillAutosaveWriter(const char *program, const char *path, Uint32 delay)
+{
+#ifdef _WIN32
+	STARTUPINFOA startup;
+	PROCESS_INFORMATION process;
+	char command[FILENAME_MAX * 2 + 32];
+	if (strlen(program) + strlen(path) + 32 > sizeof(command))
+		return -1;
+	sprintf(command, "\"%s\" --autosave-writer \"%s\"", program, path);
+	memset(&startup, 0, sizeof(startup));
+	startup.cb = sizeof(startup);
+	if (!CreateProcessA(NULL, command, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &process))
+		return -1;
+	Sleep(delay);
+	TerminateProcess(process.hProcess, 1);
+	WaitForSingleObject(process.hProcess, INFINITE);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+#else
+	pid_t child;
+	int status;
+	if ((child = fork()) == -1)
+		return -1;
+	if (child == 0)
+	{
+		execlp(program, program, "--autosave-writer", path, (char *)NULL);
+		_exit(127);
+	}
+	SDL_Delay(delay);
+	kill(child, SIGKILL);
+	waitpid(child, &status, 0);
+#endif
+	return 0;
+}
+
+/// <summary>
+/// Kills a process writing high scores through the autosave at random points and checks that the scores it
+/// leaves behind are always whole, either the old ones or the new ones.
+/// </summary>
+/// <param name="program">The path of this program.</param>
+/// <param name="path">The path of the scores, it is written over and removed.</param>
+/// <param name="rounds">The number of processes killed.</param>
+/// <returns>Returns -1 if the scores were torn once or on error, 0 otherwise.</returns>
+int TestAutosaveKill(const char *program, const char *path, int rounds)
+{
+	char temp[FILENAME_MAX];
+	Uint32 seed = 1;
+	int i, first, previous = 0, written = 0, torn = 0;
+	if (strlen(path) + 5 > sizeof(temp) || WriteFileAtomically(path, "0,1,2", 5) == -1)
+	{
+		printf("Unable to write %s\n", path);
+		return -1;
+	}
+	sprintf(temp, "%s.tmp", path);
+	for (i = 0; i < rounds; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		if (KillAutosaveWriter(program, path, 1 + (seed >> 8) % 30) == -1)
+		{
+			printf("Unable to start %s\n", program);
+			break;
+		}
+		if (ReadAutosaveScores(path, &first) == -1)
+		{
+			printf("Round %d left torn scores in %s\n", i + 1, path);
+			torn++;
+			WriteFileAtomically(path, "0,1,2", 5);
+			first = 0;
+		}
+		else if (first != previous)
+			written++;
+		previous = first;
+	}
+	printf("%d writers killed, %d left new scores, %d left torn scores\n", i, written, torn);
+	remove(path);
+	remove(temp);
+	return i == rounds && torn == 0 ? 0 : -1;
+}
+
+/// <summary>
+/// Reads a whole text file.
+/// </summary>
+/// <param name="path">The path of the file.</param>
+/// <param name="length">The length of the text.</param>
+/// <returns>Returns the text, or NULL on error.</returns>
+char *ReadLevelFile(const char *path, size_t *length)
+{
+	FILE *file;
+	char *text;
+	if ((file = fopen(path, "rt")) == NULL)
+		return NULL;
+	text = ReadLevelText(file, length);
+	fclose(file);
+	return text;
+}
+
+/// <summary>
+/// Converts a text level file to a binary pack and back to text with ConvertLevels,
+/// the text must come back byte for byte. The converted files are removed.
+/// </summary>
+/// <param name="path">The path of the text level file.</param>
+/// <returns>Returns -1 if the text changed or on error, 0 otherwise.</returns>
+int TestLevelConversion(const char *path)
+{
+	char packPath[FILENAME_MAX], textPath[FILENAME_MAX], *original = NULL, *converted = NULL;
+	size_t originalLength, convertedLength, i;
+	int result = -1;
+	if (strlen(path) + 12 > FILENAME_MAX)
+		return -1;
+	sprintf(packPath, "%s.test.pack", path);
+	sprintf(textPath, "%s.test.txt", path);
+	if (ConvertLevels(path, packPath, 0) == 0 && ConvertLevels(packPath, textPath, 0) == 0 &&
+		(original = ReadLevelFile(path, &originalLength)) != NULL &&
+		(converted = ReadLevelFile(textPath, &convertedLength)) != NULL)
+	{
+		for (i = 0; i < originalLength && i < convertedLength && original[i] == converted[i]; i++);
+		if (i == originalLength && i == convertedLength)
+		{
+			printf("%s came back from a binary pack unchanged, %lu bytes\n", path, (unsigned long)i);
+			result = 0;
+		}
+		else
+			printf("%s came back from a binary pack changed at byte %lu\n", path, (unsigned long)i);
+	}
+	else
+		printf("Unable to convert %s to a binary pack and back\n", path);
+	free(original);
+	free(converted);
+	remove(packPath);
+	remove(textPath);
+	return result;
+}
+
+/// <summary>
+/// Runs the test named by the arguments of the program.
+/// </summary>
+/// <param name="argc">The number of arguments.</param>
+/// <param name="argv">The arguments.</param>
+/// <returns>Returns the exit code of the test, -1 if the arguments do not name one.</returns>
+int RunSelfTest(int argc, char *argv[])
+{
+	if (argc == 3 && strcmp(argv[1], "--test-convert") == 0)
+		return TestLevelConversion(argv[2]) == -1 ? 1 : 0;
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "--test-autosave") == 0)
+		return TestAutosaveKill(argv[0], argv[2], argc == 4 ? atoi(argv[3]) : 200) == -1 ? 1 : 0;
+	if (argc == 3 && strcmp(argv[1], "--autosave-writer") == 0)
+		return RunAutosaveWriter(argv[2]) == -1 ? 1 : 0;
+	return -1;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef SELFTESTS_H
+#define SELFTESTS_H
+
+#include <SDL.h>
+
+//the tests are test code, they are only built with FLOW_TESTS defined:
+//Flow --test-convert defaultLevels.txt checks that the text comes back unchanged from a pack,
+//Flow --test-autosave scores.test.txt [rounds] kills processes writing scores and checks they are never torn,
+//each process is this program run with --autosave-writer scores.test.txt
+#ifdef FLOW_TESTS
+int TestLevelConversion(const char *path);
+int RunAutosaveWriter(const char *path);
+int TestAutosaveKill(const char *program, const char *path, int rounds);
+int RunSelfTest(int argc, char *argv[]);
+#endif
+
+#endif
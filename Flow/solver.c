@@ -0,0 +1,557 @@
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+
+/// <summary>
+/// Adds the neighbours of every cell of a board to it.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="to">The grown board, may be the same as from.</param>
+/// <param name="from">The board to grow.</param>
+void SpreadSolverBoard(const Solver *solver, Bitboard *to, const Bitboard *from)
+{
+	Bitboard grown, shifted;
+	int i;
+	grown = *from;
+	for (i = 0; i < solver->words; i++)
+		shifted.words[i] = from->words[i] & solver->notLastColumn.words[i];
+	BitboardShiftUp(&shifted, &shifted, 1, solver->words);
+	BitboardOr(&grown, &shifted, solver->words);
+	for (i = 0; i < solver->words; i++)
+		shifted.words[i] = from->words[i] & solver->notFirstColumn.words[i];
+	BitboardShiftDown(&shifted, &shifted, 1, solver->words);
+	BitboardOr(&grown, &shifted, solver->words);
+	BitboardShiftUp(&shifted, from, solver->size, solver->words);
+	BitboardOr(&grown, &shifted, solver->words);
+	BitboardShiftDown(&shifted, from, solver->size, solver->words);
+	BitboardOr(&grown, &shifted, solver->words);
+	for (i = 0; i < solver->words; i++)
+		to->words[i] = grown.words[i] & solver->inside.words[i];
+}
+
+/// <summary>
+/// Finds the cells with at least two and at least three neighbours a path could cover them from:
+/// free cells and the ends that can grow into them.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="freeCells">The free cells.</param>
+/// <param name="entries">The cells an end can grow into, by the direction of the end from the cell.</param>
+/// <param name="two">The cells with two or more such neighbours.</param>
+/// <param name="three">The cells with three or more such neighbours.</param>
+void CountSolverNeighbours(const Solver *solver, const Bitboard *freeCells, const Bitboard *entries, Bitboard *two, Bitboard *three)
+{
+	Bitboard up, right, down, left;
+	Uint64 a, b, c, d;
+	int i;
+	for (i = 0; i < solver->words; i++)
+	{
+		left.words[i] = freeCells->words[i] & solver->notLastColumn.words[i];
+		right.words[i] = freeCells->words[i] & solver->notFirstColumn.words[i];
+	}
+	//every board has the cells whose neighbour in one direction could cover them
+	BitboardShiftUp(&up, freeCells, solver->size, solver->words);
+	BitboardShiftDown(&right, &right, 1, solver->words);
+	BitboardShiftDown(&down, freeCells, solver->size, solver->words);
+	BitboardShiftUp(&left, &left, 1, solver->words);
+	for (i = 0; i < solver->words; i++)
+	{
+		a = up.words[i] | entries[0].words[i];
+		b = right.words[i] | entries[1].words[i];
+		c = down.words[i] | entries[2].words[i];
+		d = left.words[i] | entries[3].words[i];
+		two->words[i] = (a & c) | (b & d) | ((a | c) & (b | d));
+		three->words[i] = (a & c & (b | d)) | (b & d & (a | c));
+	}
+}
+
+/// <summary>
+/// Determines whether an end of a path can grow into a cell. A strict search only grows paths that
+/// never run next to themselves, which is how puzzles are drawn, and leaves far fewer choices.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The state.</param>
+/// <param name="end">The end, flow * 2 for the end grown from the first endpoint.</param>
+/// <param name="cell">The cell, -1 outside the board.</param>
+/// <returns>Returns 1 if the end can grow into the cell or join the other end there, 0 otherwise.</returns>
+int CanMoveSolverEnd(const Solver *solver, const SolverState *state, int end, int cell)
+{
+	int direction, neighbour;
+	if (cell == -1)
+		return 0;
+	if (cell == state->ends[end ^ 1])
+		return 1;
+	if (!BitboardTest(&state->free, cell))
+		return 0;
+	if (!solver->strict)
+		return 1;
+	//ends next to each other have to be joined
+	for (direction = 0; direction < 4; direction++)
+		if (solver->neighbours[state->ends[end]][direction] == state->ends[end ^ 1])
+			return 0;
+	for (direction = 0; direction < 4; direction++)
+	{
+		neighbour = solver->neighbours[cell][direction];
+		if (neighbour != -1 && neighbour != state->ends[end] && neighbour != state->ends[end ^ 1] &&
+			!BitboardTest(&state->free, neighbour) && state->owners[neighbour] == end >> 1)
+			return 0;
+	}
+	return 1;
+}
+
+/// <summary>
+/// Grows an end of a path by a cell, or joins it to the other end.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The state.</param>
+/// <param name="end">The end, flow * 2 for the end grown from the first endpoint.</param>
+/// <param name="direction">The direction of the cell from the end.</param>
+void MoveSolverEnd(const Solver *solver, SolverState *state, int end, int direction)
+{
+	int cell = solver->neighbours[state->ends[end]][direction];
+	if (cell == state->ends[end ^ 1])
+	{
+		state->unfinished &= ~((Uint64)1 << (end >> 1));
+		return;
+	}
+	state->owners[cell] = (Uint8)(end >> 1);
+	state->links[cell] = (Uint8)direction;
+	state->ends[end] = (Uint16)cell;
+	BitboardClear(&state->free, cell);
+}
+
+/// <summary>
+/// Makes the moves a state leaves no choice about until none is left: an end with a single cell
+/// to go to, or a free cell next to an end that has only two neighbours it could be covered from
+/// and so has to be covered through that end.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The state.</param>
+/// <returns>Returns 0 if the state is a dead end, 1 otherwise.</returns>
+int PropagateSolverState(const Solver *solver, SolverState *state)
+{
+	Bitboard entries[4], two, three;
+	Uint8 moves[SOLVER_MAX_FLOWS * 2];
+	Uint64 moved;
+	int i, end, direction, cell, forced;
+	do
+	{
+		for (direction = 0; direction < 4; direction++)
+			BitboardZero(&entries[direction], solver->words);
+		for (end = 0; end < solver->flowCount * 2; end++)
+		{
+			if ((state->unfinished & (Uint64)1 << (end >> 1)) == 0)
+				continue;
+			moves[end] = 0;
+			for (direction = 0; direction < 4; direction++)
+			{
+				cell = solver->neighbours[state->ends[end]][direction];
+				if (!CanMoveSolverEnd(solver, state, end, cell))
+					continue;
+				moves[end] |= 1 << direction;
+				if (cell != state->ends[end ^ 1])
+					BitboardSet(&entries[(direction + 2) & 3], cell);
+			}
+			if (moves[end] == 0)
+				return 0;
+		}
+		//a free cell is covered by a path coming in and going out
+		CountSolverNeighbours(solver, &state->free, entries, &two, &three);
+		for (i = 0; i < solver->words; i++)
+			if (state->free.words[i] & ~two.words[i])
+				return 0;
+		//the moves found are still forced after the moves of other flows, but may have become impossible,
+		//a flow whose other end moved may have gained the move joining the ends
+		moved = 0;
+		for (end = 0; end < solver->flowCount * 2; end++)
+		{
+			if (((state->unfinished & ~moved) & (Uint64)1 << (end >> 1)) == 0)
+				continue;
+			forced = -1;
+			for (direction = 0; direction < 4; direction++)
+			{
+				cell = solver->neighbours[state->ends[end]][direction];
+				//a free cell with two neighbours to be covered from has to take the end, whatever else the end could do
+				if ((moves[end] & 1 << direction) && cell != state->ends[end ^ 1] && !BitboardTest(&three, cell))
+					forced = direction;
+				else if (forced == -1 && moves[end] == 1 << direction)
+					forced = direction;
+			}
+			if (forced == -1)
+				continue;
+			if (!CanMoveSolverEnd(solver, state, end, solver->neighbours[state->ends[end]][forced]))
+				return 0;
+			MoveSolverEnd(solver, state, end, forced);
+			moved |= (Uint64)1 << (end >> 1);
+		}
+	} while (moved != 0);
+	return 1;
+}
+
+/// <summary>
+/// Finds a flow for a region, moving the flows of other regions to other regions they can fill if needed.
+/// </summary>
+/// <param name="candidates">The flows that can fill every region.</param>
+/// <param name="regions">The region every flow fills, -1 for none.</param>
+/// <param name="region">The region.</param>
+/// <param name="tried">The flows tried so far.</param>
+/// <returns>Returns 1 if the region got a flow, 0 otherwise.</returns>
+int MatchSolverRegion(const Uint64 *candidates, int *regions, int region, Uint64 *tried)
+{
+	Uint64 flows;
+	int flow;
+	for (flows = candidates[region] & ~*tried; flows != 0; flows &= flows - 1)
+	{
+		flow = LowestBit64(flows);
+		*tried |= (Uint64)1 << flow;
+		if (regions[flow] == -1 || MatchSolverRegion(candidates, regions, regions[flow], tried))
+		{
+			regions[flow] = region;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/// <summary>
+/// Checks that the ends of every unfinished path can still meet and that every free region can
+/// still be filled. A region is only filled by a path whose two ends both touch it, and a path
+/// runs through a single region, so every region needs a flow of its own. The regions are kept
+/// in the solver to branch on.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The state.</param>
+/// <returns>Returns 0 if the state is a dead end, 1 otherwise.</returns>
+int CheckSolverRegions(Solver *solver, const SolverState *state)
+{
+	Bitboard left, region, grown, touched;
+	Uint64 flows, word, tried, adjacent = 0, once = 0, twice = 0, candidates[SOLVER_MAX_FLOWS];
+	int matches[SOLVER_MAX_FLOWS], i, end, first, growing, cells, dark, count = 0;
+	for (flows = state->unfinished; flows != 0; flows &= flows - 1)
+	{
+		end = LowestBit64(flows) * 2;
+		for (i = 0; i < 4; i++)
+			if (solver->neighbours[state->ends[end]][i] == state->ends[end + 1])
+				adjacent |= (Uint64)1 << (end >> 1);
+	}
+	left = state->free;
+	for (first = 0; first < solver->words; first++)
+	{
+		while (left.words[first] != 0)
+		{
+			BitboardZero(&region, solver->words);
+			BitboardSet(&region, first * 64 + LowestBit64(left.words[first]));
+			do
+			{
+				SpreadSolverBoard(solver, &grown, &region);
+				growing = 0;
+				for (i = 0; i < solver->words; i++)
+				{
+					grown.words[i] &= left.words[i];
+					growing |= grown.words[i] != region.words[i];
+				}
+				region = grown;
+			} while (growing);
+			//there are more regions than flows to fill them
+			if (count == SOLVER_MAX_FLOWS)
+				return 0;
+			SpreadSolverBoard(solver, &touched, &region);
+			candidates[count] = 0;
+			for (flows = state->unfinished; flows != 0; flows &= flows - 1)
+			{
+				end = LowestBit64(flows) * 2;
+				if (BitboardTest(&touched, state->ends[end]) && BitboardTest(&touched, state->ends[end + 1]))
+				{
+					candidates[count] |= (Uint64)1 << (end >> 1);
+					solver->flowRegions[end >> 1] = (Sint8)count;
+				}
+			}
+			if (candidates[count] == 0)
+				return 0;
+			//a region only one flow can fill is a single path between its ends, going from dark
+			//to light cells and back, so the colors of its cells and ends have to add up
+			if ((candidates[count] & (candidates[count] - 1)) == 0)
+			{
+				end = LowestBit64(candidates[count]) * 2;
+				cells = BitboardCount(&region, solver->words);
+				for (i = dark = 0; i < solver->words; i++)
+					dark += PopCount64(region.words[i] & solver->dark.words[i]);
+				i = BitboardTest(&solver->dark, state->ends[end]);
+				if (BitboardTest(&solver->dark, state->ends[end + 1]) != (cells & 1 ? i : !i) ||
+					(i ? cells - dark : dark) != (cells + 1) / 2)
+					return 0;
+			}
+			for (i = first; i < solver->words; i++)
+				for (word = region.words[i]; word != 0; word &= word - 1)
+					solver->regions[i * 64 + LowestBit64(word)] = (Uint8)count;
+			twice |= once & candidates[count];
+			once |= candidates[count++];
+			BitboardAndNot(&left, &region, solver->words);
+		}
+	}
+	if ((once | adjacent) != state->unfinished)
+		return 0;
+	//the path of a flow whose ends touch a single region together runs through that region
+	for (i = 0; i < solver->flowCount; i++)
+	{
+		matches[i] = -1;
+		if (((once & ~twice & ~adjacent) & (Uint64)1 << i) == 0)
+			solver->flowRegions[i] = -1;
+	}
+	for (i = 0; i < count; i++)
+	{
+		tried = 0;
+		if (!MatchSolverRegion(candidates, matches, i, &tried))
+			return 0;
+	}
+	return 1;
+}
+
+/// <summary>
+/// Determines whether a branch of the search can grow an end of a path into a cell, which also
+/// needs the cell to be in the region the path runs through.
+/// </summary>
+/// <param name="solver">The solver, with the regions of the state.</param>
+/// <param name="state">The state.</param>
+/// <param name="end">The end, flow * 2 for the end grown from the first endpoint.</param>
+/// <param name="cell">The cell, -1 outside the board.</param>
+/// <returns>Returns 1 if the end can grow into the cell or join the other end there, 0 otherwise.</returns>
+int CanBranchSolverEnd(const Solver *solver, const SolverState *state, int end, int cell)
+{
+	if (!CanMoveSolverEnd(solver, state, end, cell))
+		return 0;
+	return cell == state->ends[end ^ 1] || solver->flowRegions[end >> 1] == -1 ||
+		solver->regions[cell] == solver->flowRegions[end >> 1];
+}
+
+/// <summary>
+/// Writes the paths of a solved state as a solution.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The solved state.</param>
+/// <param name="solution">The solution.</param>
+void WriteLevelSolution(const Solver *solver, const SolverState *state, LevelSolution *solution)
+{
+	Uint16 path[SOLVER_MAX_CELLS];
+	int flow, end, cell, count, first, i, direction;
+	solution->size = solver->size;
+	solution->flowCount = solver->flowCount;
+	for (flow = 0; flow < solver->flowCount; flow++)
+	{
+		//the cells grown from the first endpoint are walked back and turned around,
+		//then the cells grown from the last endpoint are walked back to it
+		count = 0;
+		for (end = flow * 2; end < flow * 2 + 2; end++)
+		{
+			first = count;
+			for (cell = state->ends[end]; cell != solver->endpoints[end];
+				cell = solver->neighbours[cell][(state->links[cell] + 2) & 3])
+				path[count++] = (Uint16)cell;
+			path[count++] = (Uint16)cell;
+			for (i = 0; end == flow * 2 && i < (count - first) / 2; i++)
+			{
+				cell = path[first + i];
+				path[first + i] = path[count - 1 - i];
+				path[count - 1 - i] = (Uint16)cell;
+			}
+		}
+		for (i = 0; i < count; i++)
+		{
+			solution->owners[path[i]] = (Uint8)flow;
+			solution->next[path[i]] = SOLVER_PATH_END;
+			for (direction = 0; i < count - 1 && direction < 4; direction++)
+				if (solver->neighbours[path[i]][direction] == path[i + 1])
+					solution->next[path[i]] = (Uint8)direction;
+		}
+	}
+}
+
+/// <summary>
+/// Prepares the search for the solution of a level.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="nodeLimit">The number of branches to try before giving up, 0 for no limit.</param>
+/// <returns>Returns -1 if the level has too many flows or on error, 0 otherwise.</returns>
+int InitSolver(Solver *solver, const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit)
+{
+	SolverState *state;
+	int x, y, cell, i;
+	if (def->flowCount > SOLVER_MAX_FLOWS)
+		return -1;
+	solver->size = def->size;
+	solver->flowCount = def->flowCount;
+	solver->cells = def->size * def->size;
+	solver->words = BitboardWords(def->size);
+	solver->nodes = 0;
+	solver->nodeLimit = nodeLimit;
+	solver->solutions = 0;
+	solver->solutionLimit = 1;
+	solver->cancel = NULL;
+	solver->strict = 1;
+	//a branch covers at least a cell, so the search never goes deeper than the cells
+	if ((solver->stack = (SolverState *)malloc((solver->cells + 1) * sizeof(SolverState))) == NULL)
+		return -1;
+	BitboardZero(&solver->inside, solver->words);
+	BitboardZero(&solver->dark, solver->words);
+	BitboardZero(&solver->notFirstColumn, solver->words);
+	BitboardZero(&solver->notLastColumn, solver->words);
+	for (cell = 0; cell < solver->cells; cell++)
+	{
+		x = cell % solver->size;
+		y = cell / solver->size;
+		BitboardSet(&solver->inside, cell);
+		if ((x + y) & 1)
+			BitboardSet(&solver->dark, cell);
+		if (x > 0)
+			BitboardSet(&solver->notFirstColumn, cell);
+		if (x < solver->size - 1)
+			BitboardSet(&solver->notLastColumn, cell);
+		solver->neighbours[cell][0] = (Sint16)(y > 0 ? cell - solver->size : -1);
+		solver->neighbours[cell][1] = (Sint16)(x < solver->size - 1 ? cell + 1 : -1);
+		solver->neighbours[cell][2] = (Sint16)(y < solver->size - 1 ? cell + solver->size : -1);
+		solver->neighbours[cell][3] = (Sint16)(x > 0 ? cell - 1 : -1);
+	}
+	state = &solver->stack[0];
+	state->free = solver->inside;
+	memset(state->owners, 0, solver->cells);
+	memset(state->links, 0, solver->cells);
+	state->unfinished = solver->flowCount == 64 ? ~(Uint64)0 : ((Uint64)1 << solver->flowCount) - 1;
+	for (i = 0; i < solver->flowCount * 2; i++)
+	{
+		solver->endpoints[i] = (Uint16)(endpoints[i * 2 + 1] * solver->size + endpoints[i * 2]);
+		state->ends[i] = solver->endpoints[i];
+		state->owners[state->ends[i]] = (Uint8)(i >> 1);
+		BitboardClear(&state->free, solver->endpoints[i]);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Makes the forced moves of a state and finds the moves to branch on: the end with the fewest
+/// choices, its cells with the fewest free neighbours first.
+/// </summary>
+/// <param name="solver">The solver.</param>
+/// <param name="state">The state.</param>
+/// <param name="end">Set to the end to grow.</param>
+/// <param name="moves">Set to the directions to grow the end in, in the order to try them.</param>
+/// <returns>Returns the number of moves, 0 if the state is solved, -1 if it is a dead end.</returns>
+int BranchSolverState(Solver *solver, SolverState *state, int *end, int *moves)
+{
+	int keys[4], moveCount = 0, direction, cell, key, i, j;
+	if (!PropagateSolverState(solver, state) || !CheckSolverRegions(solver, state))
+		return -1;
+	if (state->unfinished == 0)
+		return 0;
+	*end = -1;
+	for (j = 0; j < solver->flowCount * 2; j++)
+	{
+		if ((state->unfinished & (Uint64)1 << (j >> 1)) == 0)
+			continue;
+		for (i = direction = 0; direction < 4; direction++)
+			i += CanBranchSolverEnd(solver, state, j, solver->neighbours[state->ends[j]][direction]);
+		if (*end == -1 || i < moveCount)
+		{
+			*end = j;
+			moveCount = i;
+		}
+	}
+	if (moveCount == 0)
+		return -1;
+	moveCount = 0;
+	for (direction = 0; direction < 4; direction++)
+	{
+		cell = solver->neighbours[state->ends[*end]][direction];
+		if (!CanBranchSolverEnd(solver, state, *end, cell))
+			continue;
+		key = 0;
+		if (cell != state->ends[*end ^ 1])
+			for (i = 0; i < 4; i++)
+				if (solver->neighbours[cell][i] != -1 && BitboardTest(&state->free, solver->neighbours[cell][i]))
+					key++;
+		for (j = moveCount++; j > 0 && keys[j - 1] > key; j--)
+		{
+			moves[j] = moves[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		moves[j] = direction;
+		keys[j] = key;
+	}
+	return moveCount;
+}
+
+/// <summary>
+/// Searches for solutions filling the whole board from a state of the stack, trying the moves
+/// found by BranchSolverState one after the other.
+/// </summary>
+/// <param name="solver">The solver, its solutions are counted.</param>
+/// <param name="depth">The index of the state in the stack.</param>
+/// <param name="solution">The first solution found.</param>
+/// <returns>Returns 1 if the solution limit was reached, 0 if the search is over without reaching it,
+/// -1 if the node limit was reached or the search was cancelled.</returns>
+int SearchSolver(Solver *solver, int depth, LevelSolution *solution)
+{
+	SolverState *state = &solver->stack[depth];
+	int moves[4], end, moveCount, i, result;
+	if ((++solver->nodes > solver->nodeLimit && solver->nodeLimit != 0) || (solver->cancel != NULL && AtomicLoad(solver->cancel)))
+		return -1;
+	if ((moveCount = BranchSolverState(solver, state, &end, moves)) == -1)
+		return 0;
+	if (moveCount == 0)
+	{
+		if (solver->solutions++ == 0)
+			WriteLevelSolution(solver, state, solution);
+		return solver->solutions == solver->solutionLimit;
+	}
+	for (i = 0; i < moveCount; i++)
+	{
+		solver->stack[depth + 1] = *state;
+		MoveSolverEnd(solver, &solver->stack[depth + 1], end, moves[i]);
+		if ((result = SearchSolver(solver, depth + 1, solution)) != 0)
+			return result;
+	}
+	return 0;
+}
+
+/// <summary>
+/// Frees the solver.
+/// </summary>
+/// <param name="solver">The solver.</param>
+void FreeSolver(Solver *solver)
+{
+	free(solver->stack);
+	solver->stack = NULL;
+}
+
+/// <summary>
+/// Finds a solution of a level that fills the whole board.
+/// </summary>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="nodeLimit">The number of branches to try before giving up, 0 for no limit.</param>
+/// <param name="solution">The solution, set if one is found.</param>
+/// <returns>Returns 1 if a solution was found, 0 if there is none, -1 if the solver gave up or on error.</returns>
+int SolveLevel(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, LevelSolution *solution)
+{
+	Solver *solver;
+	int result;
+	//the solver is too large for the stack of a thread
+	if ((solver = (Solver *)malloc(sizeof(Solver))) == NULL)
+		return -1;
+	if (InitSolver(solver, def, endpoints, nodeLimit) == -1)
+	{
+		free(solver);
+		return -1;
+	}
+	result = SearchSolver(solver, 0, solution);
+	FreeSolver(solver);
+	//a level may only be solved by a path running next to itself, the search is repeated allowing it
+	if (result == 0 && InitSolver(solver, def, endpoints, nodeLimit) == 0)
+	{
+		solver->strict = 0;
+		result = SearchSolver(solver, 0, solution);
+		FreeSolver(solver);
+	}
+	free(solver);
+	return result;
+}
@@ -0,0 +1,57 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <SDL.h>
+#include "atomics.h"
+#include "bitboard.h"
+#include "levelpack.h"
+
+#define SOLVER_MAX_CELLS (BITBOARD_MAX_SIZE * BITBOARD_MAX_SIZE)
+#define SOLVER_MAX_FLOWS 64 //the unfinished flows of a state are the bits of a word
+#define SOLVER_PATH_END 4 //the direction of the last cell of a path, it has no next cell
+#define SOLVER_NODE_LIMIT 1000000 //the branches tried on a level of a checked pack before giving up, a few seconds
+
+//directions are 0 up, 1 right, 2 down and 3 left, as in the boards of the board store
+
+//a partial solution, the path of every flow grows from both of its endpoints until the two ends meet
+typedef struct SolverState
+{
+	Bitboard free; //the cells no path covers yet
+	Uint64 unfinished; //the flows whose ends have not met
+	Uint16 ends[SOLVER_MAX_FLOWS * 2]; //the last cell grown from every endpoint, in the order of the endpoints
+	Uint8 owners[SOLVER_MAX_CELLS]; //the flow of every covered cell
+	Uint8 links[SOLVER_MAX_CELLS]; //the direction every grown cell was entered in from the cell before it
+} SolverState;
+
+typedef struct Solver
+{
+	int size, flowCount, cells, words;
+	Uint16 endpoints[SOLVER_MAX_FLOWS * 2]; //the cell of every endpoint
+	Sint16 neighbours[SOLVER_MAX_CELLS][4]; //the cell in every direction, -1 outside the board
+	Bitboard inside, dark, notFirstColumn, notLastColumn; //dark cells are the black squares of a chessboard
+	SolverState *stack; //a state for every branch of the search, the deepest one is a branch per cell
+	Uint32 nodes, nodeLimit; //nodeLimit is 0 for a search without a limit
+	Uint32 solutions, solutionLimit; //the search stops once it found solutionLimit solutions, 0 counts them all
+	AtomicInt *cancel; //set by another thread to stop the search, NULL if there is none
+	int strict; //1 if paths may not run next to themselves
+	//the regions of the state being branched on
+	Uint8 regions[SOLVER_MAX_CELLS]; //the region of every free cell
+	Sint8 flowRegions[SOLVER_MAX_FLOWS]; //the only region a flow can run through, -1 if there are more
+} Solver;
+
+typedef struct LevelSolution
+{
+	int size, flowCount;
+	Uint8 owners[SOLVER_MAX_CELLS]; //the flow covering every cell
+	Uint8 next[SOLVER_MAX_CELLS]; //the direction of the next cell of the path, from the first endpoint of the flow
+} LevelSolution;
+
+int InitSolver(Solver *solver, const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit);
+int BranchSolverState(Solver *solver, SolverState *state, int *end, int *moves);
+void MoveSolverEnd(const Solver *solver, SolverState *state, int end, int direction);
+void WriteLevelSolution(const Solver *solver, const SolverState *state, LevelSolution *solution);
+int SearchSolver(Solver *solver, int depth, LevelSolution *solution);
+void FreeSolver(Solver *solver);
+int SolveLevel(const LevelDef *def, const Uint8 *endpoints, Uint32 nodeLimit, LevelSolution *solution);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uniquecheck.h"
+
+/// <summary>
+/// Counts the solutions of a level up to two with a SAT solver. Once the first solution is found
+/// it is ruled out and the same solver goes on to the second one, keeping the clauses it learnt.
+/// </summary>
+/// <param name="def">The level, checked by GetPlayableLevel.</param>
+/// <param name="endpoints">The endpoints of the level.</param>
+/// <param name="conflictLimit">The number of conflicts of each search before giving up, 0 for no limit.</param>
+/// <param name="solutions">The first two solutions, set as they are found.</param>
+/// <returns>Returns LevelUnique, LevelAmbiguous, LevelUnsolvable or LevelUnchecked if the solver gave up or on error.</returns>
+LevelUniqueness CheckLevelUniqueness(const LevelDef *def, const Uint8 *endpoints, Uint32 conflictLimit,
+	LevelSolution *solutions)
+{
+	LevelCnf cnf;
+	SatSolver sat;
+	LevelUniqueness uniqueness = LevelUnchecked;
+	int result;
+	if (LoadLevelSat(&cnf, &sat, def, endpoints) == -1)
+		return LevelUnchecked;
+	if ((result = FindLevelSat(&cnf, &sat, endpoints, conflictLimit, &solutions[0])) == 0)
+		uniqueness = LevelUnsolvable;
+	else if (result == 1 && RuleOutLevelSolution(&cnf, &sat, &solutions[0]) != -1)
+	{
+		if ((result = FindLevelSat(&cnf, &sat, endpoints, conflictLimit, &solutions[1])) == 0)
+			uniqueness = LevelUnique;
+		else if (result == 1)
+			uniqueness = LevelAmbiguous;
+	}
+	FreeSatSolver(&sat);
+	FreeLevelCnf(&cnf);
+	return uniqueness;
+}
+
+/// <summary>
+/// Prints two solutions of a level side by side, a letter for the flow of every cell.
+/// </summary>
+/// <param name="solutions">The solutions.</param>
+void PrintLevelWitness(const LevelSolution *solutions)
+{
+	char row[BITBOARD_MAX_SIZE * 2 + 4];
+	int x, y, i, flow, length;
+	for (y = 0; y < solutions[0].size; y++)
+	{
+		length = 0;
+		for (i = 0; i < 2; i++)
+		{
+			for (x = 0; x < solutions[i].size; x++)
+			{
+				flow = solutions[i].owners[y * solutions[i].size + x];
+				row[length++] = flow < (int)strlen(UNIQUECHECK_LETTERS) ? UNIQUECHECK_LETTERS[flow] : '#';
+			}
+			if (i == 0)
+			{
+				memcpy(&row[length], "   ", 3);
+				length += 3;
+			}
+		}
+		row[length] = '\0';
+		printf("  %s\n", row);
+	}
+}
+
+/// <summary>
+/// Prints the results of the levels checked so far that follow the levels printed.
+/// </summary>
+/// <param name="job">The job, locked.</param>
+void PrintUniqueCheckResults(UniqueCheckJob *job)
+{
+	int level;
+	for (; job->printed < job->pack->count && job->results[job->printed] != 0xff; job->printed++)
+	{
+		level = job->printed + 1;
+		switch (job->results[job->printed])
+		{
+		case LevelUnique:
+			printf("Level %d is unique\n", level);
+			break;
+		case LevelAmbiguous:
+			printf("Level %d is ambiguous\n", level);
+			if (job->witnesses[job->printed] != NULL)
+				PrintLevelWitness(job->witnesses[job->printed]);
+			free(job->witnesses[job->printed]);
+			job->witnesses[job->printed] = NULL;
+			break;
+		case LevelUnsolvable:
+			printf("Level %d has no solution\n", level);
+			break;
+		case LevelUnplayable:
+			printf("Level %d cannot be played\n", level);
+			break;
+		default:
+			printf("Gave up on level %d\n", level);
+			break;
+		}
+	}
+}
+
+/// <summary>
+/// Checks the levels of a job until there are none left, each worker thread runs this.
+/// The levels are taken from the pack under the lock, as its pages are shared.
+/// </summary>
+/// <param name="data">The job.</param>
+/// <returns>Returns 0.</returns>
+int UniqueCheckWorker(void *data)
+{
+	UniqueCheckJob *job = (UniqueCheckJob *)data;
+	LevelSolution solutions[2], *witness;
+	LevelDef def;
+	const LevelDef *found;
+	const Uint8 *levelEndpoints;
+	Uint8 endpoints[256 * 4];
+	LevelUniqueness result;
+	int level;
+	while (1)
+	{
+		found = NULL;
+		SDL_LockMutex(job->lock);
+		level = job->next++;
+		if (level < job->pack->count && (found = GetPlayableLevel(job->pack, level, &levelEndpoints)) != NULL)
+		{
+			def = *found;
+			memcpy(endpoints, levelEndpoints, def.flowCount * 4);
+		}
+		SDL_UnlockMutex(job->lock);
+		if (level >= job->pack->count)
+			break;
+		witness = NULL;
+		if (found == NULL)
+			result = LevelUnplayable;
+		else if ((result = CheckLevelUniqueness(&def, endpoints, LEVELCNF_CONFLICT_LIMIT, solutions)) == LevelAmbiguous &&
+			(witness = (LevelSolution *)malloc(2 * sizeof(LevelSolution))) != NULL)
+			memcpy(witness, solutions, 2 * sizeof(LevelSolution));
+		SDL_LockMutex(job->lock);
+		job->results[level] = (Uint8)result;
+		job->witnesses[level] = witness;
+		job->counts[result]++;
+		PrintUniqueCheckResults(job);
+		SDL_UnlockMutex(job->lock);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Checks that every level of a pack has exactly one solution on a pool of worker threads
+/// and reports every level: unique, ambiguous with two of its solutions, or without a solution.
+/// </summary>
+/// <param name="path">The path of a text or binary pack.</param>
+/// <param name="workerCount">The number of threads.</param>
+/// <returns>Returns -1 if the pack could not be read or a level is not unique, 0 otherwise.</returns>
+int CheckPackUniqueness(const char *path, int workerCount)
+{
+	UniqueCheckJob job;
+	SDL_Thread *workers[UNIQUECHECK_MAX_WORKERS];
+	LevelPack pack;
+	Uint32 start;
+	int i, line, column, result = -1;
+	if (OpenLevelPack(path, &pack) == -1 && OpenTextLevelPack(path, &pack, &line, &column) == -1)
+	{
+		printf("Unable to read %s\n", path);
+		return -1;
+	}
+	memset(&job, 0, sizeof(UniqueCheckJob));
+	job.pack = &pack;
+	if ((job.results = (Uint8 *)malloc(pack.count + 1)) == NULL ||
+		(job.witnesses = (LevelSolution **)calloc(pack.count + 1, sizeof(LevelSolution *))) == NULL)
+		printf("Out of memory\n");
+	else
+	{
+		memset(job.results, 0xff, pack.count);
+		start = SDL_GetTicks();
+		//the main thread is one of the workers, without a lock it is the only one
+		if (workerCount > pack.count)
+			workerCount = pack.count;
+		if (workerCount > UNIQUECHECK_MAX_WORKERS)
+			workerCount = UNIQUECHECK_MAX_WORKERS;
+		job.lock = SDL_CreateMutex();
+		for (i = 0; i < workerCount - 1 && job.lock != NULL; i++)
+			if ((workers[i] = SDL_CreateThread(UniqueCheckWorker, &job)) == NULL)
+				break;
+		workerCount = i;
+		UniqueCheckWorker(&job);
+		for (i = 0; i < workerCount; i++)
+			SDL_WaitThread(workers[i], NULL);
+		if (job.lock != NULL)
+			SDL_DestroyMutex(job.lock);
+		printf("%d unique, %d ambiguous, %d without a solution, %d that cannot be played and %d given up on "
+			"of %d levels on %d threads in %lu ms\n", job.counts[LevelUnique], job.counts[LevelAmbiguous],
+			job.counts[LevelUnsolvable], job.counts[LevelUnplayable], job.counts[LevelUnchecked], pack.count,
+			workerCount + 1, (unsigned long)(SDL_GetTicks() - start));
+		result = job.counts[LevelUnique] == pack.count ? 0 : -1;
+	}
+	free(job.results);
+	free(job.witnesses);
+	FreeLevelPack(&pack);
+	return result;
+}
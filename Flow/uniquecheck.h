@@ -0,0 +1,32 @@
+#ifndef UNIQUECHECK_H
+#define UNIQUECHECK_H
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "levelpack.h"
+#include "levelcnf.h"
+
+#define UNIQUECHECK_MAX_WORKERS 16
+#define UNIQUECHECK_LETTERS "RYGBCOPADEFHIJKLMNQSTUVWXZabcdefghijklmnopqrstuvwxyz0123456789" //the flows of a printed solution, as imported
+
+typedef enum LevelUniqueness
+{
+	LevelUnique, LevelAmbiguous, LevelUnsolvable, LevelUnplayable, LevelUnchecked //LevelUnchecked if the solver gave up
+} LevelUniqueness;
+
+//the levels of a pack checked by a pool of worker threads, the results are printed in the order of the levels
+typedef struct UniqueCheckJob
+{
+	LevelPack *pack;
+	Uint8 *results; //a LevelUniqueness for every level checked, 0xff until then
+	LevelSolution **witnesses; //the two solutions of an ambiguous level until it is printed
+	int next, printed; //the next level to check and the number of levels printed
+	int counts[LevelUnchecked + 1];
+	SDL_mutex *lock; //guards everything but pack, it is also held to print
+} UniqueCheckJob;
+
+LevelUniqueness CheckLevelUniqueness(const LevelDef *def, const Uint8 *endpoints, Uint32 conflictLimit,
+	LevelSolution *solutions);
+int CheckPackUniqueness(const char *path, int workerCount);
+
+#endif